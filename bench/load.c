@@ -0,0 +1,467 @@
+/* End-to-end load generator
+ * Build: make bench
+ * Usage: load [-n COUNT] [-s SEED] [-t TERMS] [-D DEPTH] [-m DIGITS] [-f PERCENT] [-g PERCENT]
+ *             [-o MIX] [-e FILE | -r FILE] [-M MODES] [-x PROGRAM]
+ * Prints one JSON object per mode, with the number of generated expressions replaced for failing, hanging or crashing */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "global.h"
+#include "mem.h"
+#include "parse.h"
+#include "status.h"
+
+#define MAX_LEN		1024	// Longest generated expression
+#define VALID_MS	200		// Longest evaluation accepted when generating corpus
+#define TIMEOUT_S	5		// Longest evaluation before a mode is abandoned
+#define RESP_MAX	4096	// Longest line read from batch mode
+
+/* Operator of the grammar in phelp(), with its share of the mix */
+struct Oper {
+	const char *tok;
+	bool unary;
+	unsigned weight;
+};
+
+/* Expression under construction */
+struct Buf {
+	char str[MAX_LEN];
+	size_t len;
+	bool full;
+};
+
+/* Results shared by in-process child */
+struct Shared {
+	size_t done, failed;
+	double lat[];
+};
+
+static struct Oper Mix[] = {
+	{"+",  false, 4}, {"-",  false, 4}, {"*",  false, 2}, {"/",  false, 2}, {"%", false, 1}, {"^", false, 1},
+	{"!",  true,  1}, {"!!", true,  1}, {"++", true,  1}, {"--", true,  1},
+};
+#define NMIX		(sizeof(Mix) / sizeof(Mix[0]))
+
+static uint64_t Seed = 0x9E3779B97F4A7C15ULL;
+static unsigned Terms = 4, Depth = 2, Digits = 3, FracPct = 25, GroupPct = 30;
+static const char *Program = "./parse";
+static size_t Replaced;	// Generated expressions that failed, hung or crashed, and were generated again
+
+/* Returns next pseudo-random number (xorshift64*) */
+static uint64_t rnd(void) {
+	Seed ^= Seed >> 12;
+	Seed ^= Seed << 25;
+	Seed ^= Seed >> 27;
+	return Seed * 2685821657736338717ULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmpdbl(const void *x, const void *y) {
+	double a = *(const double *) x, b = *(const double *) y;
+
+	return (a > b) - (a < b);
+}
+
+static void put(struct Buf *buf, const char *fmt, ...) {
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = vsnprintf(buf->str + buf->len, MAX_LEN - buf->len, fmt, args);
+	va_end(args);
+	if (len < 0 || len >= MAX_LEN - buf->len)
+		buf->full = true;
+	else
+		buf->len += len;
+}
+
+/* Returns random operator of given arity, weighted by the mix */
+static const struct Oper *pickoper(bool unary) {
+	unsigned total = 0, pick;
+
+	for (size_t index = 0; index < NMIX; index++)
+		total += Mix[index].unary == unary ? Mix[index].weight : 0;
+	if (!total)
+		return NULL;
+	pick = rnd() % total;
+	for (size_t index = 0; index < NMIX; index++) {
+		if (Mix[index].unary != unary)
+			continue;
+		if (pick < Mix[index].weight)
+			return &Mix[index];
+		pick -= Mix[index].weight;
+	}
+	return NULL;
+}
+
+/* Appends random nonzero number of at most Digits integer digits */
+static void gennum(struct Buf *buf) {
+	uint64_t limit = 1;
+
+	for (unsigned digit = 0; digit < Digits; digit++)
+		limit *= 10;
+	put(buf, "%llu", (unsigned long long) (rnd() % (limit - 1) + 1));
+	if (rnd() % 100 < FracPct)
+		put(buf, ".%02u", (unsigned) (rnd() % 100));
+}
+
+static void genexpr(struct Buf *buf, unsigned depth);
+
+/* Appends number, unary operation, or group nested at most depth levels */
+static void genterm(struct Buf *buf, unsigned depth) {
+	const struct Oper *oper;
+	unsigned unary = 0, total = 0;
+
+	if (depth && rnd() % 100 < GroupPct) {
+		if (rnd() % 2)	// Multiply terms, x(y)
+			gennum(buf);
+		put(buf, "(");
+		genexpr(buf, depth - 1);
+		put(buf, ")");
+		return;
+	}
+	for (size_t index = 0; index < NMIX; index++) {
+		unary += Mix[index].unary ? Mix[index].weight : 0;
+		total += Mix[index].weight;
+	}
+	if (!unary || rnd() % total >= unary || !(oper = pickoper(true))) {
+		gennum(buf);
+		return;
+	}
+	if (!strcmp(oper->tok, "!!"))	// Small root degree keeps results representable
+		put(buf, "%u", (unsigned) (rnd() % 4 + 2));
+	put(buf, "%s", oper->tok);
+	gennum(buf);
+}
+
+/* Appends 1 to Terms terms joined by binary operators */
+static void genexpr(struct Buf *buf, unsigned depth) {
+	const struct Oper *oper;
+	unsigned terms = rnd() % Terms + 1;
+
+	genterm(buf, depth);
+	for (unsigned term = 1; term < terms && (oper = pickoper(false)); term++) {
+		put(buf, "%s", oper->tok);
+		if (!strcmp(oper->tok, "^"))	// Small exponent keeps results representable
+			put(buf, "%u", (unsigned) (rnd() % 3 + 1));
+		else
+			genterm(buf, depth);
+	}
+}
+
+/* Returns true if expression evaluates successfully within VALID_MS */
+static bool valid(const char *expr) {
+	struct itimerval timer = {{0, 0}, {0, VALID_MS * 1000}};
+	int status;
+	pid_t child;
+
+	if ((child = fork()) == 0) {
+		setitimer(ITIMER_REAL, &timer, NULL);
+		_exit(parse(expr, 6, NULL) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	return child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+/* Fills corpus with valid random expressions, counting those replaced */
+static char **generate(size_t count) {
+	char **corpus = calloc(count, sizeof(char *));
+	struct Buf buf;
+
+	if (!corpus)
+		return NULL;
+	for (size_t index = 0; index < count; ) {
+		buf.len = 0;
+		buf.full = false;
+		buf.str[0] = '\0';
+		genexpr(&buf, Depth);
+		if (buf.full)
+			continue;
+		if (!valid(buf.str)) {
+			Replaced++;
+			continue;
+		}
+		if (!(corpus[index++] = strdup(buf.str)))
+			return NULL;
+	}
+	return corpus;
+}
+
+static bool emit(const char *path, char **corpus, size_t count) {
+	FILE *file = fopen(path, "w");
+
+	if (!file)
+		return false;
+	for (size_t index = 0; index < count; index++)
+		fprintf(file, "%s\n", corpus[index]);
+	return fclose(file) == 0;
+}
+
+/* Reads one expression per line
+ * Returns corpus and stores its size */
+static char **replay(const char *path, size_t *count) {
+	FILE *file = fopen(path, "r");
+	char **corpus = NULL, **swap, *line = NULL;
+	size_t size = 0, cap = 0;
+	ssize_t len;
+
+	if (!file)
+		return NULL;
+	*count = 0;
+	while ((len = getline(&line, &size, file)) > 0) {
+		if (line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (!len)
+			continue;
+		if (*count == cap) {
+			if (!(swap = realloc(corpus, (cap = cap ? cap * 2 : 256) * sizeof(char *))))
+				break;
+			corpus = swap;
+		}
+		if (!(corpus[(*count)++] = strdup(line)))
+			break;
+	}
+	free(line);
+	fclose(file);
+	return corpus;
+}
+
+static void report(const char *mode, size_t count, size_t done, size_t failed, double elapsed, double *lat, long maxrss) {
+	if (!done) {
+		printf("{\"bench\":\"load\",\"mode\":\"%s\",\"exprs\":%zu,\"replaced\":%zu,\"done\":0,\"timeout\":true}\n", mode, count, Replaced);
+		return;
+	}
+	qsort(lat, done, sizeof(double), cmpdbl);
+	printf("{\"bench\":\"load\",\"mode\":\"%s\",\"exprs\":%zu,\"replaced\":%zu,\"done\":%zu,\"failed\":%zu,\"timeout\":%s,"
+		   "\"ops_per_s\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f,\"maxrss_kb\":%ld}\n",
+		   mode, count, Replaced, done, failed, done < count ? "true" : "false", done / (elapsed / 1e9),
+		   lat[done / 2] / 1e3, lat[done * 99 / 100] / 1e3, lat[done * 999 / 1000] / 1e3, lat[done - 1] / 1e3, maxrss);
+	fflush(stdout);
+}
+
+/* Calls parse() directly, in a child process so its peak memory is measured alone */
+static void run_inproc(char **corpus, size_t count) {
+	size_t size = sizeof(struct Shared) + count * sizeof(double);
+	struct Shared *shared = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	struct rusage usage;
+	double begin, elapsed;
+	char *result;
+	pid_t child;
+
+	if (shared == MAP_FAILED)
+		return;
+	begin = now();
+	if ((child = fork()) == 0) {
+		for (size_t index = 0; index < count; index++) {
+			double start = now();
+
+			alarm(TIMEOUT_S);
+			if (!(result = parse(corpus[index], 6, NULL))) {
+				shared->failed++;
+				ErrStat = 0;
+			}
+			xfree(result);
+			shared->lat[index] = now() - start;
+			shared->done++;
+		}
+		_exit(EXIT_SUCCESS);
+	}
+	if (child > 0 && wait4(child, NULL, 0, &usage) == child) {
+		elapsed = now() - begin;
+		report("inproc", count, shared->done, shared->failed, elapsed, shared->lat, usage.ru_maxrss);
+	}
+	munmap(shared, size);
+}
+
+/* Runs program once per expression, given as its last argument */
+static void run_cmdline(char **corpus, size_t count) {
+	double *lat = malloc(count * sizeof(double));
+	char arg[MAX_LEN + 2];
+	size_t done = 0, failed = 0;
+	struct rusage usage;
+	long maxrss = 0;
+	double begin, start;
+	int status, null;
+	pid_t child;
+
+	if (!lat || (null = open("/dev/null", O_RDWR)) < 0)
+		return;
+	begin = now();
+	for (; done < count; done++) {
+		snprintf(arg, sizeof(arg), "%s%s", *corpus[done] == '-' ? " " : "", corpus[done]);	// Not a flag
+		start = now();
+		if ((child = fork()) == 0) {
+			dup2(null, STDIN_FILENO);
+			dup2(null, STDOUT_FILENO);
+			dup2(null, STDERR_FILENO);
+			alarm(TIMEOUT_S);	// Survives exec
+			execl(Program, Program, arg, (char *) NULL);
+			_exit(127);
+		}
+		if (child < 0 || wait4(child, &status, 0, &usage) != child || WIFSIGNALED(status))
+			break;
+		if (WEXITSTATUS(status) == 127) {
+			fprintf(stderr, "load: cannot run %s\n", Program);
+			break;
+		}
+		lat[done] = now() - start;
+		failed += WEXITSTATUS(status) != 0;
+		if (usage.ru_maxrss > maxrss)
+			maxrss = usage.ru_maxrss;
+	}
+	report("cmdline", count, done, failed, now() - begin, lat, maxrss);
+	close(null);
+	free(lat);
+}
+
+/* Reads line of response into buffer, keeping the rest for later
+ * Returns false on timeout or end of output */
+static bool readln(int fd, char *buf, size_t *len, char *line) {
+	struct pollfd pfd = {fd, POLLIN, 0};
+	char *newline;
+	ssize_t got;
+
+	while (!(newline = memchr(buf, '\n', *len))) {
+		if (*len == RESP_MAX || poll(&pfd, 1, TIMEOUT_S * 1000) <= 0 || (got = read(fd, buf + *len, RESP_MAX - *len)) <= 0)
+			return false;
+		*len += got;
+	}
+	memcpy(line, buf, newline - buf);
+	line[newline - buf] = '\0';
+	*len -= newline - buf + 1;
+	memmove(buf, newline + 1, *len);
+	return true;
+}
+
+/* Writes each expression to one process reading piped input, waiting for each answer */
+static void run_batch(char **corpus, size_t count) {
+	double *lat = malloc(count * sizeof(double));
+	char *buf = malloc(RESP_MAX), *line = malloc(RESP_MAX + 1);
+	size_t done = 0, failed = 0, len = 0;
+	int in[2], out[2], null;
+	struct rusage usage;
+	double begin, start;
+	pid_t child;
+
+	if (!lat || !buf || !line || (null = open("/dev/null", O_RDWR)) < 0 || pipe(in) || pipe(out))
+		return;
+	signal(SIGPIPE, SIG_IGN);
+	if ((child = fork()) == 0) {
+		dup2(in[0], STDIN_FILENO);
+		dup2(out[1], STDOUT_FILENO);
+		dup2(null, STDERR_FILENO);
+		close(in[1]);
+		close(out[0]);
+		execl(Program, Program, (char *) NULL);
+		_exit(127);
+	}
+	close(in[0]);
+	close(out[1]);
+	begin = now();
+	for (; child > 0 && done < count; done++) {
+		start = now();
+		if (write(in[1], corpus[done], strlen(corpus[done])) < 0 || write(in[1], "\n", 1) < 0 ||
+			!readln(out[0], buf, &len, line))
+			break;
+		lat[done] = now() - start;
+		failed += strstr(line, "Error") != NULL;
+	}
+	if (done < count)	// Stuck or gone
+		kill(child, SIGKILL);
+	else
+		write(in[1], "\n", 1);	// Empty line ends batch
+	close(in[1]);
+	if (child > 0 && wait4(child, NULL, 0, &usage) == child)
+		report("batch", count, done, failed, now() - begin, lat, usage.ru_maxrss);
+	close(out[0]);
+	close(null);
+	free(line);
+	free(buf);
+	free(lat);
+}
+
+/* Sets operator weights from list of TOKEN:WEIGHT, omitted operators are not used */
+static bool setmix(char *mix) {
+	char *tok, *colon;
+	size_t index;
+
+	for (index = 0; index < NMIX; index++)
+		Mix[index].weight = 0;
+	for (tok = strtok(mix, ","); tok; tok = strtok(NULL, ",")) {
+		colon = strrchr(tok, ':');
+		if (colon)
+			*colon = '\0';
+		for (index = 0; index < NMIX && strcmp(Mix[index].tok, tok); index++);
+		if (index == NMIX)
+			return false;
+		Mix[index].weight = colon ? strtoul(colon + 1, NULL, 10) : 1;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	const char *emit_path = NULL, *replay_path = NULL, *modes = "inproc,cmdline,batch";
+	size_t count = 1000;
+	char **corpus;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:t:D:m:f:g:o:e:r:M:x:")) != -1) {
+		switch (opt) {
+		case 'n': count = strtoul(optarg, NULL, 10);			break;
+		case 's': Seed = strtoull(optarg, NULL, 0) | 1;			break;
+		case 't': Terms = strtoul(optarg, NULL, 10);			break;
+		case 'D': Depth = strtoul(optarg, NULL, 10);			break;
+		case 'm': Digits = strtoul(optarg, NULL, 10);			break;
+		case 'f': FracPct = strtoul(optarg, NULL, 10);			break;
+		case 'g': GroupPct = strtoul(optarg, NULL, 10);			break;
+		case 'e': emit_path = optarg;							break;
+		case 'r': replay_path = optarg;							break;
+		case 'M': modes = optarg;								break;
+		case 'x': Program = optarg;								break;
+		case 'o':
+			if (!setmix(optarg)) {
+				fprintf(stderr, "load: unknown operator in mix\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (!count || !Terms || !Digits || Digits > 18) {
+		fprintf(stderr, "load: invalid corpus shape\n");
+		return EXIT_FAILURE;
+	}
+	corpus = replay_path ? replay(replay_path, &count) : generate(count);
+	if (!corpus || !count) {
+		fprintf(stderr, "load: no corpus\n");
+		return EXIT_FAILURE;
+	}
+	if (emit_path)
+		return emit(emit_path, corpus, count) ? EXIT_SUCCESS : EXIT_FAILURE;
+	if (strstr(modes, "inproc"))
+		run_inproc(corpus, count);
+	if (strstr(modes, "cmdline"))
+		run_cmdline(corpus, count);
+	if (strstr(modes, "batch"))
+		run_batch(corpus, count);
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,265 @@
+/* Microbenchmarks of the evaluator kernels
+ * Build: make bench
+ * Usage: micro [SEED]
+ * Prints one JSON object per benchmark and corpus, with the number of corpus expressions replaced for hanging or crashing */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "cache.h"
+#include "global.h"
+#include "mem.h"
+#include "parse.h"
+#include "status.h"
+#include "util.h"
+
+#define CORPUS		1024	// Inputs per corpus, more than the cache holds
+#define MIN_NS		2e8		// Shortest measurement of each benchmark
+#define BATCH		64		// Operations between clock readings
+#define MAX_LEN		4096
+#define VALID_MS	200		// Longest parse() accepted when validating corpus
+
+/* Inputs of one benchmark case */
+struct Corpus {
+	const char *name;
+	char *str[CORPUS];		// Expressions or numbers
+	size_t pos[CORPUS];		// Operator position, if any
+	double val[CORPUS];		// Numbers, if any
+	size_t bytes;			// Total length of strings
+	size_t replaced;		// Expressions on which parse() hung or crashed, replaced by validate()
+	unsigned terms, depth;	// Shape of expressions, if any
+	bool fractional;
+};
+
+typedef void (*kernel_t)(struct Corpus *corpus, size_t index);
+
+static uint64_t Seed = 0x9E3779B97F4A7C15ULL;
+static volatile double Sink;	// Keeps results alive
+
+/* Returns next pseudo-random number (xorshift64*) */
+static uint64_t rnd(void) {
+	Seed ^= Seed >> 12;
+	Seed ^= Seed << 25;
+	Seed ^= Seed >> 27;
+	return Seed * 2685821657736338717ULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Appends random number to string */
+static void addnum(char *str, bool fractional) {
+	char *end = str + strlen(str);
+
+	end += sprintf(end, "%u", (unsigned) (rnd() % 999 + 1));	// Never zero, so division is defined
+	if (fractional)
+		sprintf(end, ".%u", (unsigned) (rnd() % 100));
+}
+
+/* Appends random operator to string
+ * Products and quotients never chain, keeping results within the ten digits dtos() can print */
+static void addoper(char *str, bool *scaled) {
+	static const char opers[] = "+-*/";
+	char oper = opers[rnd() % (*scaled ? 2 : 4)];
+
+	strncat(str, &oper, 1);
+	*scaled = oper == '*' || oper == '/';
+}
+
+/* Builds expression of given number of terms, each nested to given depth (at most 2) */
+static char *genexpr(unsigned terms, unsigned depth, bool fractional) {
+	char *expr = calloc(MAX_LEN, sizeof(char));
+	bool scaled = false, inner;
+
+	for (unsigned term = 0; term < terms; term++) {
+		if (term)
+			addoper(expr, &scaled);
+		for (unsigned open = 0; open < depth; open++)
+			strcat(expr, "(");
+		addnum(expr, fractional);
+		for (unsigned close = 0; close < depth; close++) {
+			inner = false;
+			addoper(expr, &inner);
+			addnum(expr, fractional);
+			strcat(expr, ")");
+		}
+	}
+	return expr;
+}
+
+/* Replaces expressions on which parse() hangs or crashes, so every benchmark completes, counting them
+ * Each expression is tried in a child process, which reports its progress through a pipe */
+static void validate(struct Corpus *corpus) {
+	struct pollfd pfd;
+	size_t start = 0, index;
+	char *result;
+	int fds[2];
+	pid_t child;
+
+	while (start < CORPUS) {
+		if (pipe(fds))
+			return;
+		if ((child = fork()) == 0) {
+			close(fds[0]);
+			for (index = start; index <= CORPUS; index++) {
+				write(fds[1], &index, sizeof(index));
+				if (index < CORPUS && (result = parse(corpus->str[index], 6, NULL)))
+					xfree(result);
+			}
+			_exit(EXIT_SUCCESS);
+		}
+		close(fds[1]);
+		pfd = (struct pollfd) {fds[0], POLLIN, 0};
+		index = start;
+		while (poll(&pfd, 1, VALID_MS) > 0 && read(fds[0], &index, sizeof(index)) == sizeof(index));
+		kill(child, SIGKILL);
+		waitpid(child, NULL, 0);
+		close(fds[0]);
+		if (index == CORPUS)
+			break;
+		corpus->bytes -= strlen(corpus->str[index]);	// Stuck on this one
+		free(corpus->str[index]);
+		corpus->str[index] = genexpr(corpus->terms, corpus->depth, corpus->fractional);
+		corpus->pos[index] = strcspn(corpus->str[index] + 1, "+-*/") + 1;
+		corpus->bytes += strlen(corpus->str[index]);
+		corpus->replaced++;
+		start = index;
+	}
+}
+
+static void fill_exprs(struct Corpus *corpus, const char *name, unsigned terms, unsigned depth, bool fractional) {
+	corpus->name = name;
+	corpus->bytes = corpus->replaced = 0;
+	corpus->terms = terms;
+	corpus->depth = depth;
+	corpus->fractional = fractional;
+	for (size_t index = 0; index < CORPUS; index++) {
+		corpus->str[index] = genexpr(terms, depth, fractional);
+		corpus->pos[index] = strcspn(corpus->str[index] + 1, "+-*/") + 1;	// First binary operator
+		corpus->bytes += strlen(corpus->str[index]);
+	}
+	validate(corpus);
+}
+
+static void fill_nums(struct Corpus *corpus, const char *name, bool fractional) {
+	corpus->name = name;
+	corpus->bytes = corpus->replaced = 0;
+	for (size_t index = 0; index < CORPUS; index++) {
+		corpus->str[index] = calloc(32, sizeof(char));
+		addnum(corpus->str[index], fractional);
+		corpus->val[index] = strtod(corpus->str[index], NULL);
+		corpus->bytes += strlen(corpus->str[index]);
+	}
+}
+
+static void freecorpus(struct Corpus *corpus) {
+	for (size_t index = 0; index < CORPUS; index++)
+		free(corpus->str[index]);
+}
+
+static void k_stod(struct Corpus *c, size_t i)			{Sink = stod(c->str[i]);}
+static void k_getval(struct Corpus *c, size_t i)		{Sink = getval(c->str[i], c->pos[i], RIGHT);}
+static void k_getlim(struct Corpus *c, size_t i)		{Sink = getlim(c->str[i], c->pos[i], LEFT);}
+static void k_chk_syntax(struct Corpus *c, size_t i)	{Sink = chk_syntax(c->str[i]);}
+static void k_chk_parenth(struct Corpus *c, size_t i)	{Sink = chk_parenth(c->str[i]);}
+
+static void k_dtos(struct Corpus *c, size_t i) {
+	char *str = dtos(c->val[i], MaxDec);
+
+	Sink = str ? str[0] : 0;
+	xfree(str);
+}
+
+static void k_roundnum(struct Corpus *c, size_t i) {	// Includes copying input, which roundnum() frees
+	char *str = xstrdup(c->str[i]);
+
+	if (str && (str = roundnum(str, 1)))
+		Sink = str[0];
+	xfree(str);
+}
+
+static void k_pushsub(struct Corpus *c, size_t i) {	// Includes copying inputs, which pushsub() frees
+	char *str = xstrdup(c->str[i]), *sub = xstrdup("+42");
+
+	if (str && sub && (str = pushsub(str, sub, 0, c->pos[i] - 1)))
+		Sink = str[0];
+	xfree(str);
+}
+
+static void k_parse(struct Corpus *c, size_t i) {
+	char *result = parse(c->str[i], 6, NULL);
+
+	Sink = result ? result[0] : 0;
+	xfree(result);
+}
+
+/* Runs kernel over corpus until MIN_NS has passed, then prints results */
+static void run(const char *name, kernel_t kernel, struct Corpus *corpus) {
+	size_t ops = 0, allocs;
+	double begin, elapsed;
+
+	clrcache();
+	for (size_t index = 0; index < BATCH; index++)	// Warm up
+		kernel(corpus, index);
+	allocs = MemAllocs;
+	begin = now();
+	do {
+		for (size_t batch = 0; batch < BATCH; batch++, ops++)
+			kernel(corpus, ops % CORPUS);
+	} while ((elapsed = now() - begin) < MIN_NS);
+	ErrStat = 0;
+	printf("{\"bench\":\"%s\",\"corpus\":\"%s\",\"ops\":%zu,\"ns_per_op\":%.2f,\"allocs_per_op\":%.2f,"
+		   "\"ops_per_s\":%.0f,\"mb_per_s\":%.2f,\"replaced\":%zu}\n",
+		   name, corpus->name, ops, elapsed / ops, (double) (MemAllocs - allocs) / ops,
+		   ops / (elapsed / 1e9), (double) corpus->bytes / CORPUS * ops / (elapsed / 1e3), corpus->replaced);
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+	struct Corpus *corpus = malloc(sizeof(struct Corpus));
+	static const struct {const char *name; unsigned terms, depth; bool fractional;} exprs[] = {
+		{"short_shallow_int",	3,	0, false},
+		{"short_shallow_frac",	3,	0, true},
+		{"long_shallow_frac",	16,	0, true},
+		{"short_deep_int",		2,	2, false},
+		{"long_grouped_int",	32,	1, false},
+		{"long_deep_frac",		16,	2, true},
+	};
+
+	if (argc > 1)
+		Seed = strtoull(argv[1], NULL, 0) | 1;
+	if (!corpus)
+		return EXIT_FAILURE;
+	for (int frac = 0; frac < 2; frac++) {
+		fill_nums(corpus, frac ? "fractional" : "integer", frac);
+		run("stod", k_stod, corpus);
+		run("dtos", k_dtos, corpus);
+		if (frac)
+			run("roundnum", k_roundnum, corpus);
+		freecorpus(corpus);
+	}
+	for (size_t kind = 0; kind < sizeof(exprs) / sizeof(exprs[0]); kind++) {
+		fill_exprs(corpus, exprs[kind].name, exprs[kind].terms, exprs[kind].depth, exprs[kind].fractional);
+		run("chk_syntax", k_chk_syntax, corpus);
+		run("chk_parenth", k_chk_parenth, corpus);
+		if (!exprs[kind].depth) {	// Operand positions are only simple without parentheses
+			run("getval", k_getval, corpus);
+			run("getlim", k_getlim, corpus);
+			run("pushsub", k_pushsub, corpus);
+		}
+		run("parse", k_parse, corpus);
+		freecorpus(corpus);
+	}
+	free(corpus);
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+/* Throughput and latency of the shared-memory interface
+ * Build: make bench
+ * Usage: ring [REQUESTS]
+ * Prints one JSON object per measurement */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "ring.h"
+
+#define REGION	"/parse-bench"
+
+static const char *Exprs[] = {"1+1", "(2+3)^2", "12.5*(3-1.25)", "!(144)+2!!(81)", "(1.05^12)*3200/4"};
+#define NEXPRS	(sizeof(Exprs) / sizeof(Exprs[0]))
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmpdbl(const void *x, const void *y) {
+	double a = *(const double *) x, b = *(const double *) y;
+
+	return (a > b) - (a < b);
+}
+
+/* Writes request into slot in place and publishes it, unless region is closed */
+static void request(struct RingRegion *region, size_t index) {
+	struct RingSlot *slot = ring_claim(region, &region->req, true);
+	const char *expr = Exprs[index % NEXPRS];
+
+	if (!slot)
+		return;
+	slot->len = strlen(expr);
+	slot->sig = 6;
+	memcpy(slot->data, expr, slot->len + 1);
+	ring_publish(&region->req);
+}
+
+/* Reads response in place and releases it
+ * Returns false if evaluation failed, or region is closed */
+static bool response(struct RingRegion *region) {
+	struct RingSlot *slot = ring_next(region, &region->res, true);
+	int stat;
+
+	if (!slot)
+		return false;
+	stat = slot->stat;
+	ring_release(&region->res);
+	return stat == 0;
+}
+
+int main(int argc, char *argv[]) {
+	struct RingRegion *region;
+	size_t nreq = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000, sent = 0, recvd = 0, failed = 0;
+	double *lat, begin;
+	pid_t child;
+
+	if (!nreq) {	// Percentiles need at least one latency
+		fputs("ring: no requests\n", stderr);
+		return EXIT_FAILURE;
+	}
+	shm_unlink(REGION);
+	if ((child = fork()) == 0)
+		return ringserve(REGION) ? EXIT_SUCCESS : EXIT_FAILURE;
+	for (int tries = 0; !(region = ring_attach(REGION, false)) && tries < 1000; tries++)
+		usleep(1000);	// Server resets region when it attaches, so wait for it rather than create it here
+	if (!region || !(lat = malloc(nreq * sizeof(double)))) {
+		fputs("ring: setup failed\n", stderr);
+		kill(child, SIGTERM);
+		return EXIT_FAILURE;
+	}
+
+	for (size_t index = 0; index < nreq; index++) {	// Latency, one request in flight
+		begin = now();
+		request(region, index);
+		failed += !response(region);
+		lat[index] = now() - begin;
+	}
+	qsort(lat, nreq, sizeof(double), cmpdbl);
+	printf("{\"bench\":\"ring_latency\",\"requests\":%zu,\"p50_ns\":%.0f,\"p99_ns\":%.0f,\"p999_ns\":%.0f,\"max_ns\":%.0f}\n",
+		nreq, lat[nreq / 2], lat[nreq * 99 / 100], lat[nreq * 999 / 1000], lat[nreq - 1]);
+
+	begin = now();
+	while (recvd < nreq) {	// Throughput, ring kept full
+		while (sent < nreq && sent - recvd < RING_SLOTS)
+			request(region, sent++);
+		failed += !response(region);
+		recvd++;
+	}
+	printf("{\"bench\":\"ring_throughput\",\"requests\":%zu,\"ns_per_op\":%.1f,\"ops_per_s\":%.0f,\"failed\":%zu}\n",
+		nreq, (now() - begin) / nreq, nreq / ((now() - begin) / 1e9), failed);
+
+	atomic_store(&region->closed, true);
+	waitpid(child, NULL, 0);
+	ring_detach(region);
+	free(lat);
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+/* Interleaved evaluation with the resumable API, as an event loop would drive it
+ * Build: make bench
+ * Usage: task [TASKS] [PASSES]
+ * Prints one JSON object per benchmark */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "global.h"
+#include "mem.h"
+#include "parse.h"
+#include "status.h"
+#include "task.h"
+
+static const char *Exprs[] = {"1+1", "(2+3)^2", "12.5*(3-1.25)", "!(144)+2!!(81)", "(1.05^12)*3200/4",
+							  "1+2-3+4-5+6-7+8-9+10", "2^3^2-1", "-(4.5)+3*2"};
+#define NEXPRS	(sizeof(Exprs) / sizeof(Exprs[0]))
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmpdbl(const void *x, const void *y) {
+	double a = *(const double *) x, b = *(const double *) y;
+
+	return (a > b) - (a < b);
+}
+
+int main(int argc, char *argv[]) {
+	size_t ntask = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000, nstep = 0, left, failed = 0, wrong = 0;
+	unsigned passes = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+	char *expect[NEXPRS];
+	struct Task *tasks;
+	enum TaskStatus status;
+	_Atomic bool stop = true;
+	double *lat, begin, elapsed;
+
+	if (!ntask || !passes || !(tasks = calloc(ntask, sizeof(struct Task))) || !(lat = malloc(ntask * 64 * sizeof(double)))) {
+		fputs("task: setup failed\n", stderr);
+		return EXIT_FAILURE;
+	}
+	for (size_t index = 0; index < NEXPRS; index++)	// Reference results, evaluated whole
+		expect[index] = parse(Exprs[index], 6, NULL);
+
+	begin = now();
+	for (size_t index = 0; index < ntask; index++) {
+		clrstat();
+		if (!task_start(&tasks[index], Exprs[index % NEXPRS], 6))
+			failed++;
+	}
+	for (left = ntask - failed; left;) {	// Round robin, each task given a few passes at a time
+		for (size_t index = 0; index < ntask; index++) {
+			if (!tasks[index].expr && !tasks[index].sub)	// Finished, failed to start, or freed
+				continue;
+			elapsed = now();
+			status = task_step(&tasks[index], passes);
+			if (nstep < ntask * 64)
+				lat[nstep++] = now() - elapsed;
+			if (status == TASK_YIELD)
+				continue;
+			if (status == TASK_FAIL)
+				failed++;
+			else if (!expect[index % NEXPRS] || strcmp(tasks[index].result, expect[index % NEXPRS]))
+				wrong++;
+			task_free(&tasks[index]);
+			left--;
+		}
+	}
+	elapsed = now() - begin;
+	qsort(lat, nstep, sizeof(double), cmpdbl);
+	printf("{\"bench\":\"task_interleaved\",\"tasks\":%zu,\"passes\":%u,\"steps\":%zu,\"ns_per_task\":%.1f,"
+		   "\"step_p50_ns\":%.0f,\"step_p99_ns\":%.0f,\"step_max_ns\":%.0f,\"failed\":%zu,\"wrong\":%zu}\n",
+		   ntask, passes, nstep, elapsed / ntask, lat[nstep / 2], lat[nstep * 99 / 100], lat[nstep - 1], failed, wrong);
+
+	failed = 0;	// Cancellation is seen by the next step
+	begin = now();
+	for (size_t index = 0; index < ntask; index++) {
+		if (!task_start(&tasks[index], Exprs[5], 6))
+			continue;
+		tasks[index].cancel = &stop;
+		failed += task_step(&tasks[index], passes) == TASK_FAIL && ErrStat == ERR_CANCELLED;
+		task_free(&tasks[index]);
+	}
+	printf("{\"bench\":\"task_cancel\",\"tasks\":%zu,\"ns_per_task\":%.1f,\"cancelled\":%zu}\n",
+		   ntask, (now() - begin) / ntask, failed);
+
+	for (size_t index = 0; index < NEXPRS; index++)
+		xfree(expect[index]);
+	free(tasks);
+	free(lat);
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
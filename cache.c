@@ -0,0 +1,144 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+#include "global.h"
+#include "mem.h"
+
+#define NBUCKET	(CACHE_SIZE * 2)	// Hash chains, kept sparse
+
+struct CacheEntry {
+	char *key, *val;			// Canonical subexpression and its result
+	uint64_t hash;
+	struct CacheEntry *chain;	// Next entry in hash bucket
+	struct CacheEntry *newer;	// LRU neighbours
+	struct CacheEntry *older;
+};
+
+size_t CacheHits = 0, CacheMisses = 0;
+bool CacheFrozen = false;
+
+static struct CacheEntry Entries[CACHE_SIZE];
+static struct CacheEntry *Buckets[NBUCKET];
+static struct CacheEntry *Newest = NULL, *Oldest = NULL;
+static size_t NEntries = 0;
+
+/* Hashes non-space characters of string (FNV-1a) */
+static uint64_t hashcanon(const char *str) {
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (; *str; str++) {
+		if (isspace(*str))
+			continue;
+		hash ^= (unsigned char) *str;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/* Returns true if canonical key matches string, ignoring whitespace in the latter */
+static bool canoneq(const char *key, const char *str) {
+	while (true) {
+		while (isspace(*str))	str++;
+		if (*key != *str)
+			return false;
+		if (!*key)
+			return true;
+		key++, str++;
+	}
+}
+
+/* Moves entry to front of LRU list */
+static void touch(struct CacheEntry *entry) {
+	if (entry == Newest)
+		return;
+	if (entry->older)
+		entry->older->newer = entry->newer;
+	if (entry->newer)
+		entry->newer->older = entry->older;
+	if (entry == Oldest)
+		Oldest = entry->newer;
+	entry->older = Newest;
+	entry->newer = NULL;
+	if (Newest)
+		Newest->newer = entry;
+	Newest = entry;
+	if (!Oldest)
+		Oldest = entry;
+}
+
+/* Removes entry from its hash bucket and frees its strings */
+static void evict(struct CacheEntry *entry) {
+	struct CacheEntry **link = &Buckets[entry->hash % NBUCKET];
+
+	while (*link != entry)	link = &(*link)->chain;
+	*link = entry->chain;
+	free(entry->key);
+	free(entry->val);
+	entry->key = entry->val = NULL;
+}
+
+void clrcache(void) {
+	for (size_t index = 0; index < NEntries; index++) {
+		free(Entries[index].key);
+		free(Entries[index].val);
+	}
+	memset(Entries, 0, sizeof(Entries));
+	memset(Buckets, 0, sizeof(Buckets));
+	Newest = Oldest = NULL;
+	NEntries = 0;
+}
+
+char *getcache(const char *sub) {
+	uint64_t hash = hashcanon(sub);
+	char *result;
+
+	for (struct CacheEntry *entry = Buckets[hash % NBUCKET]; entry; entry = entry->chain) {
+		if (entry->hash == hash && canoneq(entry->key, sub)) {
+			if (!(result = xstrdup(entry->val)))
+				break;	// Treat as miss, caller evaluates normally
+			if (!CacheFrozen) {
+				touch(entry);
+				CacheHits++;
+			}
+			return result;
+		}
+	}
+	if (!CacheFrozen)
+		CacheMisses++;
+	return NULL;
+}
+
+bool putcache(const char *sub, const char *result) {
+	struct CacheEntry *entry;
+	char *key, *val;
+	size_t index = 0;
+
+	if (CacheFrozen)
+		return true;
+	if (!(key = malloc(strlen(sub) + 1)))
+		return false;
+	for (; *sub; sub++)	// Store without whitespace
+		if (!isspace(*sub))
+			key[index++] = *sub;
+	key[index] = '\0';
+	if (!(val = strdup(result))) {
+		free(key);
+		return false;
+	}
+	if (NEntries < CACHE_SIZE)
+		entry = &Entries[NEntries++];
+	else {
+		entry = Oldest;
+		evict(entry);
+	}
+	entry->key = key;
+	entry->val = val;
+	entry->hash = hashcanon(key);
+	entry->chain = Buckets[entry->hash % NBUCKET];
+	Buckets[entry->hash % NBUCKET] = entry;
+	touch(entry);
+	return true;
+}
\ No newline at end of file
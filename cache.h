@@ -0,0 +1,29 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>	// bool
+#include <stddef.h>		// size_t
+#include "global.h"		// attribute()
+
+#define CACHE_SIZE	256	// Maximum number of cached subexpressions
+
+extern size_t CacheHits;	// Lookups answered from cache
+extern size_t CacheMisses;	// Lookups requiring evaluation
+extern bool CacheFrozen;	// Lookups are neither counted nor reorder entries, and results are not stored, so that previews leave cache as it was
+
+/* Frees all cached subexpressions */
+extern void clrcache(void);
+
+/* Returns new, malloc'd result of previously evaluated subexpression
+ * Whitespace is ignored when comparing subexpressions
+ * On success, result must be freed
+ * Returns NULL if subexpression is not cached */
+extern char *getcache(const char *sub)
+attribute(__warn_unused_result__, __nonnull__(1));
+
+/* Caches result of subexpression, evicting least recently used entry if full
+ * Returns false on failure */
+extern bool putcache(const char *sub, const char *result)
+attribute(__nonnull__(1, 2));
+
+#endif // #ifndef CACHE_H
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "decimal.h"
+#include "global.h"
+#include "mem.h"
+#include "status.h"
+
+#define DEC_DIGITS	40	// Most digits of a 128-bit integer, plus one
+
+typedef unsigned __int128 udec_t;
+
+unsigned DecScale = 2;
+enum Rounding DecRound = HALF_EVEN;
+
+static dec_t One = 100;	// 1 at current scale
+
+/* Returns 10^exp, or 0 on overflow */
+static dec_t pow10dec(unsigned exp) {
+	dec_t pow = 1;
+
+	while (exp--)
+		if (__builtin_mul_overflow(pow, 10, &pow))
+			return 0;
+	return pow;
+}
+
+/* Divides with rounding of the remainder
+ * Returns false if result does not fit */
+static bool divround(dec_t num, dec_t den, dec_t *quot) {
+	bool neg = (num < 0) != (den < 0);
+	udec_t n = num < 0 ? -(udec_t) num : num;
+	udec_t d = den < 0 ? -(udec_t) den : den;
+	udec_t q = n / d, r = n % d;
+
+	if (r > d - r || r == d - r && (DecRound == HALF_UP || q & 1))
+		q++;
+	if (q > (udec_t) ((dec_t) ((udec_t) -1 >> 1)))
+		return false;
+	*quot = neg ? -(dec_t) q : (dec_t) q;
+	return true;
+}
+
+/* Returns 256-bit product of magnitudes as high and low halves, by 64-bit limbs */
+static udec_t widemul(udec_t x, udec_t y, udec_t *low) {
+	udec_t x0 = (uint64_t) x, x1 = x >> 64, y0 = (uint64_t) y, y1 = y >> 64;
+	udec_t p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+	udec_t mid = (p00 >> 64) + (uint64_t) p01 + (uint64_t) p10;
+
+	*low = (uint64_t) p00 | mid << 64;
+	return p11 + (p01 >> 64) + (p10 >> 64) + (mid >> 64);
+}
+
+/* Returns x * y / den, rounded, through a 256-bit intermediate product where 128 bits do not hold it
+ * Returns false if result does not fit */
+static bool muldiv(dec_t x, dec_t y, dec_t den, dec_t *result) {
+	bool neg = (x < 0) != (y < 0) != (den < 0);
+	udec_t high, low, rem, quot = 0;
+	udec_t d = den < 0 ? -(udec_t) den : den;
+	dec_t raw;
+
+	if (!__builtin_mul_overflow(x, y, &raw))
+		return divround(raw, den, result);
+	high = widemul(x < 0 ? -(udec_t) x : x, y < 0 ? -(udec_t) y : y, &low);
+	if (high >= d)	// Quotient would not fit in 128 bits
+		return false;
+	rem = high;
+	for (int bit = 127; bit >= 0; bit--) {	// Long division of low half, remainder always below 2^127
+		rem = rem << 1 | (low >> bit & 1);
+		quot <<= 1;
+		if (rem >= d) {
+			rem -= d;
+			quot |= 1;
+		}
+	}
+	if (rem > d - rem || rem == d - rem && (DecRound == HALF_UP || quot & 1))
+		quot++;
+	if (quot > (udec_t) ((dec_t) ((udec_t) -1 >> 1)))
+		return false;
+	*result = neg ? -(dec_t) quot : (dec_t) quot;
+	return true;
+}
+
+/* Scaled product, rounded back to scale */
+static bool decmul(dec_t x, dec_t y, dec_t *prod) {
+	return muldiv(x, y, One, prod);
+}
+
+/* Scaled quotient, rounded to scale */
+static bool decdiv(dec_t x, dec_t y, dec_t *quot) {
+	return muldiv(x, One, y, quot);
+}
+
+bool dtodec(double x, dec_t *dec) {
+	long double scaled = (long double) x * One;
+
+	if (isnan(x)) {
+		setstat(ERR_IMAGINARY);
+		return false;
+	}
+	if (!(fabsl(scaled) < 1e38L)) {
+		setstat(ERR_OVERFLOW);
+		return false;
+	}
+	*dec = (dec_t) (DecRound == HALF_UP ? roundl(scaled) : nearbyintl(scaled));
+	return true;
+}
+
+static double dectod(dec_t x) {
+	return (double) x / (double) One;
+}
+
+/* Raises to whole power by squaring, with as many guard digits beyond the scale as 128 bits leave room for,
+ * rounding to the scale only once at the end
+ * Returns false with error status set on failure */
+static bool decpow(dec_t base, long exp, dec_t *pow) {
+	unsigned long count = labs(exp);
+	double digits = count * log10(fabs(dectod(base)));	// Whole digits of result, negative if below 1
+	unsigned whole, guard = 0;
+	dec_t one, scaled, result;
+
+	if (!exp || !base) {
+		if (exp < 0) {
+			setstat(ERR_DIVZERO);
+			return false;
+		}
+		*pow = exp ? 0 : One;
+		return true;
+	}
+	whole = (exp < 0 ? fabs(digits) : fmax(digits, 0)) + 1;	// Of largest value met, power or reciprocal
+	if (whole + DecScale < DEC_DIGITS - 2)
+		guard = DEC_DIGITS - 2 - whole - DecScale;
+	one = pow10dec(DecScale + guard);
+	if (__builtin_mul_overflow(base, pow10dec(guard), &scaled))
+		goto overflow;
+	for (result = one; count; count >>= 1) {
+		if (count & 1 && !muldiv(result, scaled, one, &result) ||
+			count > 1 && !muldiv(scaled, scaled, one, &scaled))
+			goto overflow;
+	}
+	if (exp < 0) {
+		if (!result) {	// Below even the guard digits
+			setstat(ERR_DIVZERO);
+			return false;
+		}
+		if (!muldiv(one, one, result, &result))
+			goto overflow;
+	}
+	if (!divround(result, pow10dec(guard), pow))
+		goto overflow;
+	return true;
+overflow:
+	setstat(ERR_OVERFLOW);
+	return false;
+}
+
+bool decinit(unsigned scale, enum Rounding round) {
+	if (scale > DEC_MAXSCALE)
+		return false;
+	DecScale = scale;
+	DecRound = round;
+	One = pow10dec(scale);
+	return true;
+}
+
+bool stodec(const char *str, size_t low, size_t high, dec_t *x) {
+	char chr;
+	bool neg = false, exp_neg = false, is_sci = false, read_decim = false;
+	unsigned places = 0, exp = 0;
+	dec_t mant = 0;
+
+	for (size_t index = low; index <= high && (chr = str[index]); index++) {
+		if (chr == '-') {
+			if (is_sci)
+				exp_neg = true;
+			else
+				neg = true;
+		} else if (chr == '.')
+			read_decim = true;
+		else if (chr == 'E')
+			is_sci = true;
+		else if (isdigit(chr)) {
+			if (is_sci) {
+				if ((exp = exp * 10 + chr - '0') > 99)
+					goto overflow;
+			} else {
+				if (__builtin_mul_overflow(mant, 10, &mant) || __builtin_add_overflow(mant, chr - '0', &mant))
+					goto overflow;
+				places += read_decim;
+			}
+		}
+	}
+	return scaledec(neg ? -mant : mant, (int) places - (exp_neg ? -(int) exp : (int) exp), x);
+overflow:
+	setstat(ERR_OVERFLOW);
+	return false;
+}
+
+bool scaledec(dec_t coef, int places, dec_t *x) {
+	int shift = DecScale - places;
+	dec_t pow;
+
+	if (shift >= 0) {
+		if (!(pow = pow10dec(shift)) || __builtin_mul_overflow(coef, pow, x)) {
+			setstat(ERR_OVERFLOW);
+			return false;
+		}
+	} else if (-shift > 38)
+		*x = 0;
+	else if (!divround(coef, pow10dec(-shift), x)) {
+		setstat(ERR_OVERFLOW);
+		return false;
+	}
+	return true;
+}
+
+char *dectos(dec_t x, bool sign) {
+	char buf[DEC_DIGITS + 3 /* Sign, decimal point, null character */], *end = buf + sizeof(buf);
+	udec_t mag = x < 0 ? -(udec_t) x : x;
+	unsigned place = 0;
+
+	*--end = '\0';
+	do {
+		if (place++ == DecScale && DecScale)
+			*--end = '.';
+		*--end = '0' + mag % 10;
+		mag /= 10;
+	} while (mag || place <= DecScale);
+	if (x < 0)
+		*--end = '-';
+	else if (sign)
+		*--end = '+';	// Positive sign required for proper parse() functionality
+	return xstrdup(end);
+}
+
+bool deccalc(const char *oper, dec_t lval, dec_t rval, dec_t *result) {
+	bool unary = oper[1] ? oper[0] != '!' : oper[0] == '!';	// Square root, increment, decrement
+	double root;
+
+	switch (oper[0]) {
+	case '^':
+		if (rval % One == 0 && rval / One >= -64 && rval / One <= 64)	// Whole powers are exact
+			return decpow(lval, rval / One, result);
+		return dtodec(pow(dectod(lval), dectod(rval)), result);
+	case '*':
+		if (!decmul(lval, rval, result))
+			goto overflow;
+		return true;
+	case '/':
+	case '%':
+		if (!rval) {
+			setstat(ERR_DIVZERO);
+			return false;
+		}
+		if (oper[0] == '%')
+			*result = lval < 0 ? rval - lval : lval % rval;
+		else if (!decdiv(lval, rval, result))
+			goto overflow;
+		return true;
+	case '+':
+		if (unary ? __builtin_add_overflow(rval, One, result) : __builtin_add_overflow(lval, rval, result))
+			goto overflow;
+		return true;
+	case '-':
+		if (unary ? __builtin_sub_overflow(rval, One, result) : __builtin_sub_overflow(lval, rval, result))
+			goto overflow;
+		return true;
+	case '!':				// Roots are not exact, so are rounded to scale
+		if (unary)
+			lval = 2 * One;
+		root = dectod(lval);
+		if (rval < 0 && (intmax_t) root % 2 == 0) {
+			setstat(ERR_IMAGINARY);
+			return false;
+		}
+		if (!lval) {
+			setstat(ERR_DIVZERO);
+			return false;
+		}
+		return dtodec(rval < 0 ? -pow(-dectod(rval), 1 / root) : pow(dectod(rval), 1 / root), result);
+	}
+	setstat(ERR_INTERNAL);
+	return false;
+overflow:
+	setstat(ERR_OVERFLOW);
+	return false;
+}
+
+char *decoper(const char *expr, size_t operpos, const char *oper, ssize_t *llim, ssize_t rlim) {
+	size_t opernum = strlen(oper);
+	bool unary = opernum == 1 ? oper[0] == '!' : oper[0] != '!';
+	dec_t lval = 0, rval, result;
+
+	if (!unary && *llim < operpos && !stodec(expr, *llim, operpos - 1, &lval) ||
+		!stodec(expr, operpos + opernum, rlim, &rval) ||
+		!deccalc(oper, lval, rval, &result))
+		return NULL;
+	if (unary)
+		*llim = operpos;
+	return dectos(result, true);
+}
+
+char *rounddec(char *str) {
+	dec_t x;
+	bool read = stodec(str, 0, strlen(str) - 1, &x);
+
+	xfree(str);
+	return read ? dectos(x, false) : NULL;
+}
\ No newline at end of file
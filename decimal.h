@@ -0,0 +1,68 @@
+#ifndef DECIMAL_H
+#define DECIMAL_H
+
+#include <stdbool.h>	// bool
+#include <stddef.h>		// size_t
+#include "global.h"		// attribute(), ssize_t
+
+/* Exact fixed-point arithmetic, used in place of doubles when Flags.fixed is set
+ * Values are integers scaled by 10^DecScale */
+
+#define DEC_MAXSCALE	18	// Most decimal places kept
+
+typedef __int128 dec_t;
+
+enum Rounding {HALF_EVEN, HALF_UP};
+
+extern unsigned DecScale;		// Decimal places kept
+extern enum Rounding DecRound;	// Rounding of digits beyond scale
+
+/* Sets scale and rounding of fixed-point mode
+ * Returns false if scale is too large */
+extern bool decinit(unsigned scale, enum Rounding round);
+
+/* Reads number spanning given indices, skipping spaces, with the sign rules of stod()
+ * Digits beyond the scale are rounded
+ * Returns false on overflow */
+extern bool stodec(const char *str, size_t low, size_t high, dec_t *x)
+attribute(__nonnull__(1, 4));
+
+/* Rescales integer coefficient of given decimal places to the fixed scale, rounding
+ * Returns false on overflow */
+extern bool scaledec(dec_t coef, int places, dec_t *x)
+attribute(__nonnull__(3));
+
+/* Returns nearest fixed-point value of double, for operations that are not exact anyway
+ * Returns false on failure */
+extern bool dtodec(double x, dec_t *dec)
+attribute(__nonnull__(2));
+
+/* Returns null-terminated, malloc'd string of fixed-point number with every decimal place of the scale
+ * A positive sign is only printed if requested
+ * On success, result must be freed
+ * Returns NULL on failure */
+extern char *dectos(dec_t x, bool sign)
+attribute(__warn_unused_result__);
+
+/* Applies operator, as written in expression, to fixed-point operands
+ * Increment, decrement and square root ignore the left-hand value
+ * Returns false on failure */
+extern bool deccalc(const char *oper, dec_t lval, dec_t rval, dec_t *result)
+attribute(__nonnull__(1, 4));
+
+/* Returns null-terminated, malloc'd result of operation at operand position, as dtos() would print it
+ * Operands are read straight from the expression, between the given limits
+ * Left-hand limit is moved to the operator for unary operations
+ * On success, result must be freed
+ * Returns NULL on failure */
+extern char *decoper(const char *expr, size_t operpos, const char *oper, ssize_t *llim, ssize_t rlim)
+attribute(__warn_unused_result__, __nonnull__(1, 3, 4));
+
+/* Returns number string rewritten at the fixed scale
+ * Frees original string
+ * On success, result must be freed
+ * Returns NULL on failure */
+extern char *rounddec(char *str)
+attribute(__warn_unused_result__, __nonnull__(1));
+
+#endif // #ifndef DECIMAL_H
\ No newline at end of file
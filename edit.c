@@ -0,0 +1,279 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+#include "edit.h"
+#include "global.h"
+#include "mem.h"
+#include "parse.h"
+#include "stats.h"
+#include "status.h"
+#include "stmt.h"
+#include "trace.h"
+#include "util.h"
+
+#if UNIX
+#include <termios.h>
+#include <unistd.h>
+#endif // #if UNIX
+
+#define ctrlkey(chr)	((chr) & 0x1F)
+
+static char *History[HIST_SIZE];
+static size_t NHist = 0;
+
+void clrhist(void) {
+	for (size_t index = 0; index < NHist; index++)
+		free(History[index]);
+	NHist = 0;
+}
+
+#if UNIX
+struct LineBuffer {
+	char *str;
+	size_t len, cap, pos;	// Length, capacity, and cursor position
+};
+
+/* Adds line to history, dropping the oldest one if full */
+static void addhist(const char *line) {
+	char *copy;
+
+	if (!*line || NHist && !strcmp(History[NHist - 1], line))
+		return;
+	if (!(copy = strdup(line)))
+		return;
+	if (NHist == HIST_SIZE) {
+		free(History[0]);
+		memmove(History, History + 1, (HIST_SIZE - 1) * sizeof(char *));
+		NHist--;
+	}
+	History[NHist++] = copy;
+}
+
+/* Replaces contents of line buffer
+ * Returns false on failure */
+static bool setline(struct LineBuffer *line, const char *str) {
+	size_t len = strlen(str);
+	char *swap;
+
+	if (len + 1 > line->cap) {
+		if (!(swap = realloc(line->str, len + 1)))
+			return false;
+		line->str = swap;
+		line->cap = len + 1;
+	}
+	memcpy(line->str, str, len + 1);
+	line->len = line->pos = len;
+	return true;
+}
+
+/* Inserts character at cursor
+ * Returns false on failure */
+static bool insert(struct LineBuffer *line, char chr) {
+	char *swap;
+
+	if (line->len + 2 > line->cap) {
+		if (!(swap = realloc(line->str, line->cap * 2)))
+			return false;
+		line->str = swap;
+		line->cap *= 2;
+	}
+	memmove(line->str + line->pos + 1, line->str + line->pos, line->len - line->pos + 1);
+	line->str[line->pos++] = chr;
+	line->len++;
+	return true;
+}
+
+/* Returns result of line as Enter would evaluate it, to at most MaxDec places
+ * Cache, statistics, trace, variables and error record are left as they were, so that typing is not counted as evaluation
+ * Cached results are still used, so each keystroke only evaluates what is new
+ * Returns NULL if line does not evaluate */
+static char *dryrun(const char *str, unsigned sig) {
+	const char *errstr = ErrStr;
+	size_t errpos = ErrPos, errlen = ErrLen, peak = MemPeak;
+	int errstat = ErrStat;
+	bool tracing = Tracing;
+	char *result;
+
+	CacheFrozen = StatsOff = true;
+	Tracing = false;
+	markvars();
+	result = parse_line(str, sig > MaxDec ? MaxDec : sig);
+	undovars();
+	CacheFrozen = StatsOff = false;
+	Tracing = tracing;
+	ErrStat = errstat;	// Incomplete input is expected while typing
+	ErrStr = errstr;
+	ErrPos = errpos;
+	ErrLen = errlen;
+	MemPeak = peak;
+	return result;
+}
+
+/* Redraws prompt and line, followed by a preview of its result */
+static void redraw(const struct LineBuffer *line, unsigned sig, bool preview) {
+	char *result = NULL;
+
+	printf("\r> %s\e[K", line->str);
+	if (preview && line->len)
+		result = dryrun(line->str, sig);
+	if (result) {
+		printf(F_DIM "  = %s" F_CLR, result);
+		xfree(result);
+	}
+	printf("\r\e[" SIZE_FMT "C", line->pos + 2);
+	fflush(stdout);
+}
+
+/* Reads remainder of escape sequence and returns its final character */
+static char getesc(void) {
+	char seq[2];
+
+	if (read(STDIN_FILENO, &seq[0], 1) != 1 || seq[0] != '[' && seq[0] != 'O')
+		return '\0';
+	if (read(STDIN_FILENO, &seq[1], 1) != 1)
+		return '\0';
+	if (seq[1] >= '0' && seq[1] <= '9') {	// Extended sequence, e.g. delete is "[3~"
+		char tilde;
+
+		if (read(STDIN_FILENO, &tilde, 1) != 1 || tilde != '~')
+			return '\0';
+		return seq[1] == '3' ? 'X' : '\0';
+	}
+	return seq[1];
+}
+#endif // #if UNIX
+
+char *editln(size_t lim, unsigned sig) {
+#if UNIX
+	struct termios cooked, raw;
+	struct LineBuffer line = {NULL, 0, 16, 0};
+	char *draft = NULL, *result = NULL, chr;
+	size_t histpos = NHist;
+	bool done = false;
+
+	if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || tcgetattr(STDIN_FILENO, &cooked))
+		return getln(lim);
+	if (!(line.str = calloc(line.cap, sizeof(char)))) {
+		setstat(ERR_INTERNAL);
+		return NULL;
+	}
+	raw = cooked;
+	raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+	raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+	raw.c_cc[VMIN] = 1;
+	raw.c_cc[VTIME] = 0;
+	if (tcsetattr(STDIN_FILENO, TCSADRAIN, &raw)) {
+		free(line.str);
+		return getln(lim);
+	}
+	redraw(&line, sig, false);
+	while (!done) {
+		if (read(STDIN_FILENO, &chr, 1) != 1) {
+			line.len = line.pos = 0;	// End of input, treat as empty line
+			line.str[0] = '\0';
+			break;
+		}
+		switch (chr) {
+		case '\r': case '\n':
+			done = true;
+			break;
+		case ctrlkey('D'):
+			if (line.len)
+				break;
+			done = true;
+			break;
+		case ctrlkey('C'):
+			printf("\r> %s\e[K^C\r\n", line.str);
+			line.len = line.pos = 0;
+			line.str[0] = '\0';
+			histpos = NHist;
+			break;
+		case 127: case ctrlkey('H'):
+			if (!line.pos)
+				break;
+			memmove(line.str + line.pos - 1, line.str + line.pos, line.len - line.pos + 1);
+			line.pos--, line.len--;
+			break;
+		case ctrlkey('A'):
+			line.pos = 0;
+			break;
+		case ctrlkey('E'):
+			line.pos = line.len;
+			break;
+		case ctrlkey('U'):
+			memmove(line.str, line.str + line.pos, line.len - line.pos + 1);
+			line.len -= line.pos;
+			line.pos = 0;
+			break;
+		case '\e':
+			switch (getesc()) {
+			case 'A':	// Up
+				if (!histpos)
+					break;
+				if (histpos == NHist) {	// Keep line being edited
+					free(draft);
+					draft = strdup(line.str);
+				}
+				if (!setline(&line, History[--histpos]))
+					goto fail;
+				break;
+			case 'B':	// Down
+				if (histpos == NHist)
+					break;
+				if (!setline(&line, ++histpos == NHist ? (draft ? draft : "") : History[histpos]))
+					goto fail;
+				break;
+			case 'C':	// Right
+				if (line.pos < line.len)
+					line.pos++;
+				break;
+			case 'D':	// Left
+				if (line.pos)
+					line.pos--;
+				break;
+			case 'H':	// Home
+				line.pos = 0;
+				break;
+			case 'F':	// End
+				line.pos = line.len;
+				break;
+			case 'X':	// Delete
+				if (line.pos == line.len)
+					break;
+				memmove(line.str + line.pos, line.str + line.pos + 1, line.len - line.pos);
+				line.len--;
+				break;
+			}
+			break;
+		default:
+			if ((unsigned char) chr < ' ' || line.len + 1 >= lim - 1)
+				break;
+			if (!insert(&line, chr))
+				goto fail;
+		}
+		redraw(&line, sig, !done);
+	}
+	printf("\r\n");
+	tcsetattr(STDIN_FILENO, TCSADRAIN, &cooked);
+	addhist(line.str);
+	if ((result = malloc(line.len + 2))) {	// Same form as getln(), newline included
+		memcpy(result, line.str, line.len);
+		result[line.len] = '\n';
+		result[line.len + 1] = '\0';
+	} else
+		setstat(ERR_INTERNAL);
+	free(line.str);
+	free(draft);
+	return result;
+fail:
+	tcsetattr(STDIN_FILENO, TCSADRAIN, &cooked);
+	setstat(ERR_INTERNAL);
+	free(line.str);
+	free(draft);
+	return NULL;
+#else
+	return getln(lim);
+#endif // #if UNIX
+}
\ No newline at end of file
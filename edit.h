@@ -0,0 +1,20 @@
+#ifndef EDIT_H
+#define EDIT_H
+
+#include <stddef.h>	// size_t
+#include "global.h"	// attribute()
+
+#define HIST_SIZE	100	// Maximum number of remembered lines
+
+/* Frees line history */
+extern void clrhist(void);
+
+/* Returns null-terminated, malloc'd line read from terminal to a certain number of characters, including null character
+ * Supports cursor movement and history, and previews the result of the line as it is typed
+ * Falls back to getln() if stdin is not a terminal
+ * On success, result must be freed, even when no input is given
+ * Returns NULL on failure */
+extern char *editln(size_t lim, unsigned sig)
+attribute(__warn_unused_result__);
+
+#endif // #ifndef EDIT_H
\ No newline at end of file
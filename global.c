@@ -2,15 +2,14 @@
 #include <stdint.h>
 #include "global.h"
 
-const struct CharacterSets ChrSets = {
-	"+-!^*/%.()1234567890E\'",	// Valid characters
-	"+-!^*/%",					// Operators
-	"+-!",						// Double operators
-};
 struct ProgramFlags Flags = {
 	false,						// Significant digits	-d [INT]
 	false,						// Show help			-h
-	false						// Radian mode			-r
+	false,						// Radian mode			-r
+	false,						// Stage statistics		--stats
+	false,						// Fixed-point decimals	--fixed SCALE
+	false,						// JSON error records	--json-errors
+	false						// Exact fractions		--rational
 };
 bool CmdLn;
 
@@ -2,6 +2,7 @@
 #define GLOBAL_H
 
 #define UNIX 	defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#define LINUX	defined(__linux__)
 #define GNU		defined(__GNUC__)
 #define WIN64	defined(_WIN64)
 
@@ -44,16 +45,15 @@ typedef long	ssize_t;
 
 #define F_BLD	"\e[1m"	// Bold
 #define F_UND	"\e[4m"	// Underline
+#define F_DIM	"\e[2m"	// Faint
 #define F_CLR	"\e[0m"	// Clear formatting
 
 enum ReturnState     {PASS = INT_MIN, FAIL = INT_MAX};
 enum Direction       {LEFT, RIGHT, UP, DOWN};
-struct CharacterSets {char *valid, *opers, *doubl;};
-struct ProgramFlags  {bool round, help, radian;};
+struct ProgramFlags  {bool round, help, radian, stats, fixed, json, rational;};
 typedef enum Direction direct_t;
 typedef const char *format_t;
 
-extern const struct CharacterSets ChrSets;
 extern struct ProgramFlags Flags;
 extern bool CmdLn;				// Using command-line interface?
 
@@ -2,24 +2,128 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "cache.h"
+#include "decimal.h"
+#include "edit.h"
 #include "global.h"
+#include "mem.h"
 #include "parse.h"
+#include "rational.h"
+#include "record.h"
+#include "ring.h"
+#include "serve.h"
+#include "shard.h"
+#include "stats.h"
 #include "status.h"
+#include "stmt.h"
+#include "trace.h"
 #include "util.h"
+#include "vec.h"
+#include "watch.h"
 
 /* Prints the help page */
 void phelp(void);
 
+/* Prints remaining stage statistics at exit */
+void pstats_exit(void);
+
+/* Evaluates expression or statements, printing result on its own line
+ * With --rational, single expressions are printed as their digits are found
+ * Returns false on failure */
+bool answer(const char *expr, unsigned sig);
+
 int main(int argc, char *argv[]) {
 	char *expr, *swap, chr;
-	bool help_only = false, field_is_last = false;
+	char *serve_path = NULL, *conn_path = NULL;	// UNIX domain sockets
+	char *ring_name = NULL;						// Shared-memory region
+	char *watch_path = NULL;					// Sheet evaluated on change
+	unsigned long njob = 0;						// Worker processes of sharded batch
+	size_t used = 0;							// Last argument taken as the value of a flag
+	size_t trace_arg = 0;						// Argument holding trace file
+	bool help_only = false, batch = false;
+	bool records = false, encode = false, decode = false;	// Binary record modes
 	unsigned field = 1;
 	double result;
 	double ndec = 6;	// Number of decimal places, default is 6 (same as printf)
 
-	if (atexit(clrstat))
+	if (atexit(clrstat) || atexit(clrcache) || atexit(clrhist) || atexit(clrvars))
 		return EXIT_FAILURE;
 	for (size_t arg = 1; arg < argc; arg++) {	// Get Flags
+		if (!strncmp(argv[arg], "--", 2)) {		// Long flags
+			if (!strcmp(argv[arg] + 2, "stats")) {
+				Flags.stats = true;
+				continue;
+			}
+			if (!strcmp(argv[arg] + 2, "json-errors")) {
+				Flags.json = true;
+				continue;
+			}
+			if (!strcmp(argv[arg] + 2, "rational")) {
+				Flags.rational = true;
+				continue;
+			}
+			if (!strcmp(argv[arg] + 2, "records") || !strcmp(argv[arg] + 2, "encode") || !strcmp(argv[arg] + 2, "decode")) {
+				records |= argv[arg][2] == 'r';
+				encode |= argv[arg][2] == 'e';
+				decode |= argv[arg][2] == 'd';
+				continue;
+			}
+			if (arg == argc - 1) {				// Remaining long flags take one argument
+				setstat(ERR_INVARG);
+				setinv(NULL, arg);
+				break;
+			}
+			if (!strcmp(argv[arg] + 2, "serve"))
+				serve_path = argv[++arg];
+			else if (!strcmp(argv[arg] + 2, "connect"))
+				conn_path = argv[++arg];
+			else if (!strcmp(argv[arg] + 2, "ring"))
+				ring_name = argv[++arg];
+			else if (!strcmp(argv[arg] + 2, "watch"))
+				watch_path = argv[++arg];
+			else if (!strcmp(argv[arg] + 2, "jobs")) {
+				njob = strtoul(argv[++arg], &swap, 10);
+				if (*swap || !njob || njob > SHARD_MAXJOB) {
+					setstat(ERR_INVARG);
+					setinv(NULL, arg);
+					break;
+				}
+			}
+			else if (!strcmp(argv[arg] + 2, "fixed")) {
+				if (!isdigit(*argv[++arg]) || !decinit(strtoul(argv[arg], &swap, 10), DecRound) || *swap) {
+					setstat(ERR_INVDEC);
+					break;
+				}
+				Flags.fixed = true;
+			} else if (!strcmp(argv[arg] + 2, "round")) {
+				if (!strcmp(argv[++arg], "even"))
+					DecRound = HALF_EVEN;
+				else if (!strcmp(argv[arg], "up"))
+					DecRound = HALF_UP;
+				else {
+					setstat(ERR_INVARG);
+					setinv(NULL, arg);
+					break;
+				}
+			} else if (!strcmp(argv[arg] + 2, "mem-budget")) {
+				MemBudget = strtoull(argv[++arg], &swap, 10);
+				if (*swap || !MemBudget) {
+					setstat(ERR_INVARG);
+					setinv(NULL, arg);
+					break;
+				}
+			} else if (!strcmp(argv[arg] + 2, "trace")) {
+				if (!trace_open(argv[trace_arg = ++arg]) || atexit(trace_close))
+					break;
+			}
+			else {
+				setstat(ERR_INVFLAG);
+				setinv(argv[arg], 2);
+				break;
+			}
+			used = arg;
+			continue;
+		}
 		if (*argv[arg] != '-') {
 			if (!strchr(argv[arg - 1], 'd') && argc < argc - 1) {
 				setstat(ERR_INVARG);
@@ -33,17 +137,17 @@ int main(int argc, char *argv[]) {
 					Flags.help = true;
 					break;
 				case 'd':
-					if (arg == argc - 1) {
+					if (arg + field >= argc) {	// Each -d takes the next unused argument
 						setstat(ERR_INVARG);
 						setinv(NULL, arg);
-						break;					}
+						break;
+					}
 					ndec = stod(argv[arg + field]);
-					if (ndec < 0 || ndec > MaxDec || !iswhole(ndec)) {
+					if (ndec < 0 || ndec > RAT_MAXDEC || !iswhole(ndec)) {	// More than MaxDec only with --rational
 						setstat(ERR_INVDEC);
 						break;
 					}
-					if (arg + field == argc - 1)
-						field_is_last = true;
+					used = arg + field;
 					Flags.round = true;
 					field++;
 					break;
@@ -56,7 +160,15 @@ int main(int argc, char *argv[]) {
 				}
 			}
 		}
-		field = 0;
+		field = 1;
+	}
+	if (Flags.rational)	// Exact already
+		Flags.fixed = false;
+	else if (ndec > MaxDec && ErrStat <= 0)
+		setstat(ERR_INVDEC);
+	if (trace_arg && (serve_path || njob) && ErrStat <= 0) {	// Trace is written by one process only
+		setstat(ERR_INVARG);
+		setinv(NULL, trace_arg);
 	}
 	if (ErrStat > 0) {
 		pstatus();
@@ -69,25 +181,92 @@ int main(int argc, char *argv[]) {
 		putchar('\n');	// Seperate help page from normal output
 	}
 
+	if (Flags.stats && atexit(pstats_exit))
+		return EXIT_FAILURE;
+#if UNIX
+	batch = !isatty(STDIN_FILENO);
+#endif // #if UNIX
+
+	/* Server */
+	if (serve_path) {
+		if (!serve(serve_path)) {
+			pstatus();
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	/* Shared memory */
+	if (ring_name) {
+		if (!ringserve(ring_name)) {
+			pstatus();
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	/* Sheet */
+	if (watch_path) {
+		if (!watch(watch_path, ndec)) {
+			pstatus();
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	/* Sharded batch */
+	if (njob) {
+		if (!shardserve(njob, ndec, STDIN_FILENO, STDOUT_FILENO)) {
+			pstatus();
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	/* Binary records */
+	if (records || encode || decode) {
+		if (records ? !recserve(STDIN_FILENO, STDOUT_FILENO) :
+			encode ? !recencode(stdin, stdout) : !recdecode(stdin, stdout, ndec)) {
+			if (ErrStat > 0)
+				pstatus();
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	if (argc > 1 && used < argc - 1 && *argv[argc - 1] != '-')	// Last argument is expression, unless it is a flag or its value
+		expr = argv[argc - 1];
+	else
+		expr = NULL;
+
+	/* Client */
+	if (conn_path) {
+		CmdLn = true;
+		if (!client(conn_path, expr, ndec)) {
+			if (ErrStat > 0)
+				pstatus();
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
 	/* Command-line */
-	if (*argv[argc - 1] != '-' && !strchr(argv[argc > 1 ? argc - 2 : argc - 1], 'd') && argc > 1) {
+	if (expr) {
 		CmdLn = true;
-		if (strlen(expr = argv[argc - 1]) >= MaxLn) {			setstat(ERR_INPUTSIZE);
+		if (strlen(expr) >= MaxLn) {			setstat(ERR_INPUTSIZE);
 			pstatus();
 			return EXIT_FAILURE;
 		}
-		if (!(expr = parse(expr, ndec, NULL))) {
+		if (!answer(expr, ndec)) {
 			pstatus();
 			return EXIT_FAILURE;
 		}
-		puts(expr);
-		free(expr);
 	/* Interactive */
 	} else {
 		CmdLn = false;
 		while (true) {
 			printf("> ");
-			if (!(expr = getln(MaxLn))) {	// Subtract 1 because string length does not count null character
+			if (!(expr = editln(MaxLn, ndec))) {	// Subtract 1 because string length does not count null character
 				pstatus();
 				continue;
 			}
@@ -96,29 +275,68 @@ int main(int argc, char *argv[]) {
 				break;
 			}
 			expr[strlen(expr) - 1] = '\0';	// Remove newline
-			swap = expr;	// Swap causes 'still reachable' error in valgrind
-			expr = parse(expr, ndec, NULL);
-			free(swap);
-			if (expr) {
-				puts(expr);
-				free(expr);
-			} else
-				pstatus();
+			if (!answer(expr, ndec))
+				pstatus();	// Error refers to input, so is printed before input is freed
+			free(expr);
+			if (batch) {	// Answer each line as it arrives, so another program can wait for it
+				fflush(stdout);
+				if (Flags.stats)	// Per line in batch mode, otherwise at exit
+					pstats(stderr);
+			}
 		}
 	}
 
 	return EXIT_SUCCESS;
 }
 
+bool answer(const char *expr, unsigned sig) {
+	char *result;
+
+	if (Flags.rational && !isstmts(expr) && !isvec(expr)) {
+		if (!print_rat(expr, sig, stdout))
+			return false;
+		putchar('\n');
+		return true;
+	}
+	if (!(result = parse_line(expr, sig)))
+		return false;
+	puts(result);
+	xfree(result);
+	return true;
+}
+
+void pstats_exit(void) {
+	fflush(stdout);
+	pstats(stderr);
+}
+
 void phelp(void) {
 	puts("Usage: parse [FLAGS] [EXPRESSION]    Command-line");
 	puts("       parse                         Interactive ");
+	puts("       parse --serve SOCKET          Server      ");
 	puts("High-accuracy terminal calculator\n");
 
 	puts("Flags");
-	puts("-d [INT]   Round to # of decimals");
+	puts("-d [INT]   Round to # of decimals, at most 15, or 1000000 with --rational");
 	puts("-h         Show help page");
-	puts("-r         Radian mode\n");
+	puts("-r         Radian mode");
+	puts("--serve SOCKET      Evaluate requests from clients of UNIX socket");
+	puts("--connect SOCKET    Send expression, or each line of input, to server");
+	puts("--ring NAME         Evaluate requests from shared-memory region");
+	puts("--watch FILE        Evaluate each line of FILE, then each line changed whenever it is saved");
+	puts("--records           Evaluate binary request records from input, writing response records");
+	puts("--jobs N            Evaluate each line of input across N processes, restarting any that crash");
+	puts("                    variables assigned on a line are only seen by that line");
+	puts("--encode            Convert each line of input to a binary request record");
+	puts("--decode            Convert binary response records from input to text");
+	puts("--stats             Print cache and memory use, and time spent in each stage");
+	puts("                    if built with -DSTATS, per line of piped input");
+	puts("--trace FILE        Write rewrite steps to FILE in Chrome trace format, not with --serve or --jobs");
+	puts("--mem-budget BYTES  Limit memory held by one evaluation");
+	puts("--json-errors       Print each error as one JSON object");
+	puts("--fixed SCALE       Exact decimal arithmetic to SCALE places (at most 18), ignores -d");
+	puts("--round even|up     Rounding of --fixed: half to even (default) or half up");
+	puts("--rational          Exact fractions of 128-bit integers, ignores --fixed\n");
 
 	puts("Operators");
 	puts("++, --     ++x, --x         Increment, decrement");
@@ -130,6 +348,16 @@ void phelp(void) {
 	puts("           (x + y)          Control precedence");
 	puts("           x(y)             Multiply terms\n");
 
+	puts("Statements");
+	puts("x; y                        Evaluate each, in order");
+	puts("name = x                    Assign result to name, for use in later statements\n");
+
+	puts("Vectors and matrices");
+	puts("[x, y, z]                   Vector");
+	puts("[[a, b], [c, d]]            Matrix, one vector per row");
+	puts("x + y, x * y, ...           Apply to each element, repeating operands of size 1");
+	puts("x@y                         Dot product of vectors, or matrix product\n");
+
 	puts("GitHub repository: https://github.com/crypticcu/eval");
 	puts("Report bugs to:    cryptic.cu@protonmail.com");
 }
\ No newline at end of file
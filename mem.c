@@ -0,0 +1,118 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+#include "mem.h"
+#include "stats.h"
+#include "status.h"
+
+/* Precedes every buffer, keeping its size for xfree() */
+union MemHeader {
+	size_t size;
+	max_align_t align;
+};
+
+size_t MemBudget = 0, MemUsed = 0, MemPeak = 0, MemAllocs = 0;
+
+static size_t MemBase = 0;	// Bytes held before current evaluation began
+
+/* Accounts for growth of given number of bytes
+ * Returns false if budget would be exceeded */
+static bool charge(size_t size) {
+	if (MemBudget && MemUsed + size > MemBase + MemBudget) {
+		setstat(ERR_MEMLIMIT);
+		return false;
+	}
+	MemUsed += size;
+	if (MemUsed > MemBase && MemUsed - MemBase > MemPeak)
+		MemPeak = MemUsed - MemBase;
+	MemAllocs++;
+	stat_alloc(size);
+	return true;
+}
+
+void mem_begin(void) {
+	MemBase = MemUsed;
+	MemPeak = 0;
+}
+
+size_t mem_held(void) {
+	return MemUsed > MemBase ? MemUsed - MemBase : 0;
+}
+
+void mem_resume(size_t held) {
+	MemBase = MemUsed > held ? MemUsed - held : 0;
+}
+
+void *xmalloc(size_t size) {
+	union MemHeader *header;
+
+	if (size > SIZE_MAX - sizeof(union MemHeader)) {
+		setstat(ERR_INTERNAL);
+		return NULL;
+	}
+	if (!charge(size))
+		return NULL;
+	if (!(header = malloc(sizeof(union MemHeader) + size))) {
+		MemUsed -= size;
+		setstat(ERR_INTERNAL);
+		return NULL;
+	}
+	header->size = size;
+	return header + 1;
+}
+
+void *xcalloc(size_t num, size_t size) {
+	void *ptr;
+
+	if (size && num > SIZE_MAX / size) {
+		setstat(ERR_INTERNAL);
+		return NULL;
+	}
+	if ((ptr = xmalloc(num * size)))
+		memset(ptr, 0, num * size);
+	return ptr;
+}
+
+void *xrealloc(void *ptr, size_t size) {
+	union MemHeader *header, *swap;
+	size_t old;
+
+	if (!ptr)
+		return xmalloc(size);
+	header = (union MemHeader *) ptr - 1;
+	old = header->size;
+	if (size > old && !charge(size - old))
+		return NULL;
+	if (!(swap = realloc(header, sizeof(union MemHeader) + size))) {
+		if (size > old)
+			MemUsed -= size - old;
+		setstat(ERR_INTERNAL);
+		return NULL;
+	}
+	if (size < old)
+		MemUsed -= old - size;
+	swap->size = size;
+	return swap + 1;
+}
+
+char *xstrdup(const char *str) {
+	size_t size = strlen(str) + 1;
+	char *copy;
+
+	if ((copy = xmalloc(size)))
+		memcpy(copy, str, size);
+	return copy;
+}
+
+void xfree(void *ptr) {
+	union MemHeader *header;
+
+	if (!ptr)
+		return;
+	header = (union MemHeader *) ptr - 1;
+	MemUsed -= header->size;
+	free(header);
+}
\ No newline at end of file
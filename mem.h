@@ -0,0 +1,38 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>	// size_t
+#include "global.h"	// attribute()
+
+/* Every buffer of an evaluation is allocated here so that its size can be accounted for
+ * Buffers allocated here must be freed with xfree(), and vice versa */
+
+extern size_t MemBudget;	// Most bytes one evaluation may hold at once, 0 for no limit
+extern size_t MemUsed;		// Bytes currently held by evaluator
+extern size_t MemPeak;		// Most bytes held during current evaluation
+extern size_t MemAllocs;	// Allocations made since program start
+
+/* Begins accounting of new evaluation, resetting its peak usage */
+extern void mem_begin(void);
+
+/* Returns bytes held by current evaluation */
+extern size_t mem_held(void);
+
+/* Continues accounting of suspended evaluation holding given number of bytes, so that evaluations may be interleaved */
+extern void mem_resume(size_t held);
+
+/* Equivalent to malloc(), calloc(), realloc() and strdup()
+ * Return NULL with error status set if out of memory or over budget */
+extern void *xmalloc(size_t size)
+attribute(__warn_unused_result__, __malloc__);
+extern void *xcalloc(size_t num, size_t size)
+attribute(__warn_unused_result__, __malloc__);
+extern void *xrealloc(void *ptr, size_t size)
+attribute(__warn_unused_result__);
+extern char *xstrdup(const char *str)
+attribute(__warn_unused_result__, __malloc__, __nonnull__(1));
+
+/* Equivalent to free() */
+extern void xfree(void *ptr);
+
+#endif // #ifndef MEM_H
\ No newline at end of file
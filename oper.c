@@ -0,0 +1,128 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "global.h"
+#include "oper.h"
+#include "stats.h"
+#include "status.h"
+
+static bool exponent(double lval, double rval, double *result) {
+	*result = pow(lval, rval);
+	return true;
+}
+
+static bool product(double lval, double rval, double *result) {
+	*result = lval * rval;
+	return true;
+}
+
+static bool quotient(double lval, double rval, double *result) {
+	if (!rval) {
+		setstat(ERR_DIVZERO);
+		return false;
+	}
+	*result = lval / rval;
+	return true;
+}
+
+static bool modulus(double lval, double rval, double *result) {
+	*result = lval < 0 ? rval - lval : fmod(lval, rval);
+	return true;
+}
+
+static bool sum(double lval, double rval, double *result) {
+	*result = lval + rval;
+	return true;
+}
+
+static bool difference(double lval, double rval, double *result) {
+	*result = lval - rval;
+	return true;
+}
+
+static bool increment(double lval, double rval, double *result) {
+	*result = rval + 1;
+	return true;
+}
+
+static bool decrement(double lval, double rval, double *result) {
+	*result = rval - 1;
+	return true;
+}
+
+/* Takes root of given degree */
+static bool root(double lval, double rval, double *result) {
+	if (rval < 0 && (intmax_t) lval % 2 == 0) {
+		setstat(ERR_IMAGINARY);
+		return false;
+	}
+	if (!lval) {
+		setstat(ERR_DIVZERO);
+		return false;
+	}
+	*result = rval < 0 ? -pow(-rval, 1 / lval) : pow(rval, 1 / lval);
+	return true;
+}
+
+static bool sqroot(double lval, double rval, double *result) {
+	return root(2, rval, result);
+}
+
+const struct Operator Opers[NOPER] = {
+	[OP_INCR]	= {"++", 1, 10,	LEFT,	0,			STG_INCR,	increment},
+	[OP_DECR]	= {"--", 1, 9,	LEFT,	OPF_SIGN,	STG_DECR,	decrement},	// Increments may leave "--"
+	[OP_ROOT]	= {"!!", 2, 7,	LEFT,	0,			STG_ROOT,	root},
+	[OP_SQRT]	= {"!",  1, 8,	LEFT,	0,			STG_SQRT,	sqroot},
+	[OP_EXP]	= {"^",  2, 6,	LEFT,	0,			STG_EXP,	exponent},
+	[OP_DIV]	= {"/",  2, 5,	LEFT,	0,			STG_DIV,	quotient},
+	[OP_MUL]	= {"*",  2, 4,	LEFT,	0,			STG_MUL,	product},
+	[OP_MOD]	= {"%",  2, 3,	LEFT,	0,			STG_MOD,	modulus},
+	[OP_SUB]	= {"-",  2, 2,	LEFT,	OPF_SIGN,	STG_SUB,	difference},
+	[OP_ADD]	= {"+",  2, 1,	LEFT,	OPF_SIGN,	STG_ADD,	sum},
+};
+
+/* Operator of each character alone, and doubled */
+static const struct Operator *const Single[UCHAR_MAX + 1] = {
+	['+'] = &Opers[OP_ADD], ['-'] = &Opers[OP_SUB], ['!'] = &Opers[OP_SQRT], ['^'] = &Opers[OP_EXP],
+	['*'] = &Opers[OP_MUL], ['/'] = &Opers[OP_DIV], ['%'] = &Opers[OP_MOD],
+};
+static const struct Operator *const Double[UCHAR_MAX + 1] = {
+	['+'] = &Opers[OP_INCR], ['-'] = &Opers[OP_DECR], ['!'] = &Opers[OP_ROOT],
+};
+
+#define OPER	(CHR_VALID | CHR_OPER)
+#define DOUBL	(CHR_VALID | CHR_OPER | CHR_DOUBL)
+
+/* Only characters of text expressions are valid; '[', ']', ',', '@', ';', '=' and names are not,
+ * since vectors and statements are told apart and evaluated by their own readers before chk_syntax() sees them */
+const unsigned char ChrClass[UCHAR_MAX + 1] = {
+	['+'] = DOUBL, ['-'] = DOUBL, ['!'] = DOUBL,
+	['^'] = OPER, ['*'] = OPER, ['/'] = OPER, ['%'] = OPER,
+	['0'] = CHR_VALID, ['1'] = CHR_VALID, ['2'] = CHR_VALID, ['3'] = CHR_VALID, ['4'] = CHR_VALID,
+	['5'] = CHR_VALID, ['6'] = CHR_VALID, ['7'] = CHR_VALID, ['8'] = CHR_VALID, ['9'] = CHR_VALID,
+	['.'] = CHR_VALID, ['('] = CHR_VALID, [')'] = CHR_VALID, ['E'] = CHR_VALID, ['\''] = CHR_VALID,
+};
+
+const struct Operator *lexoper(const char *str, size_t len) {
+	unsigned char chr = str[0];
+
+	if (!len || !ischr(chr, CHR_OPER))
+		return NULL;
+	if (len > 1 && str[1] == chr && Double[chr])
+		return Double[chr];
+	return Single[chr];
+}
+
+unsigned operset(const char *expr) {
+	unsigned present = 0;
+	unsigned char chr;
+
+	for (; (chr = *expr); expr++) {
+		if (!ischr(chr, CHR_OPER))
+			continue;
+		present |= 1u << (Single[chr] - Opers);
+		if (expr[1] == chr && Double[chr])
+			present |= 1u << (Double[chr] - Opers);
+	}
+	return present;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef OPER_H
+#define OPER_H
+
+#include <limits.h>		// UCHAR_MAX
+#include <stdbool.h>	// bool
+#include <stddef.h>		// size_t
+#include "global.h"		// attribute(), direct_t
+#include "stats.h"		// enum Stage
+
+/* Operator table
+ * Each operator is described once, in the order parse_sub() applies them
+ * The validator, the text evaluator and the recursive-descent evaluators read it through lookups indexed by byte */
+
+#define CHR_VALID	0x01	// May appear in text expression
+#define CHR_OPER	0x02	// Begins an operator
+#define CHR_DOUBL	0x04	// Forms another operator when doubled
+
+#define OPF_SIGN	0x01	// Formed by signs that earlier passes leave, so its pass always runs
+
+#define PREC_MIN	1	// Lowest precedence
+#define PREC_BINARY	7	// Highest precedence of binary operators
+
+/* Returns true if character belongs to any of given classes */
+#define ischr(chr, cls)	(ChrClass[(unsigned char) (chr)] & (cls))
+
+enum OperatorId {OP_INCR, OP_DECR, OP_ROOT, OP_SQRT, OP_EXP, OP_DIV, OP_MUL, OP_MOD, OP_SUB, OP_ADD, NOPER};
+
+struct Operator {
+	const char *symbol;
+	unsigned arity;		// 1 for prefix operators, 2 for binary operators
+	unsigned prec;		// Precedence, higher binds tighter
+	direct_t assoc;		// Grouping of operators of equal precedence, LEFT or RIGHT
+	unsigned flags;
+	enum Stage stage;	// Recorded under, with --stats
+	bool (*kernel)(double lval, double rval, double *result);	// Prefix operators ignore lval
+};
+
+extern const struct Operator Opers[NOPER];
+extern const unsigned char ChrClass[UCHAR_MAX + 1];
+
+/* Returns operator at beginning of string of given length, or NULL if there is none
+ * Doubled characters are read as one operator, such as ++ */
+extern const struct Operator *lexoper(const char *str, size_t len)
+attribute(__nonnull__(1));
+
+/* Returns set of operators appearing in expression, one bit per index of Opers
+ * Doubled characters count as both operators, as parse_oper() matches either */
+extern unsigned operset(const char *expr)
+attribute(__nonnull__(1));
+
+#endif // #ifndef OPER_H
\ No newline at end of file
@@ -2,55 +2,91 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include "cache.h"
+#include "decimal.h"
 #include "global.h"
+#include "mem.h"
+#include "oper.h"
 #include "parse.h"
+#include "stats.h"
 #include "status.h"
+#include "trace.h"
+#include "rational.h"
 #include "util.h"
+#include "vec.h"
 
 char *parse(const char *expression, unsigned sig, void *null) {
-	char *sub, chr;
+	char *sub, *cached, chr;
 	char *expr;	// Dynamic buffer
-	bool read_parenth = false;
-	size_t par_low, par_high, ignore, index;
+	bool read_parenth = false, hit;
+	size_t par_low, par_high, ignore, index, before;
+	double begin;
 
-	if (!(expr = strdup(expression))) {
-		setstat(ERR_INTERNAL);
+	if (!null)	// Account for each evaluation separately
+		mem_begin();
+	if (!null && Flags.rational && !isvec(expression))	// Whole expression is evaluated exactly, not as text
+		return parse_rat(expression, sig);
+	if (sig > MaxDec)	// Only rationals have more places
+		sig = MaxDec;
+	if (!null && isvec(expression))	// Elements are evaluated in bulk, not as text
+		return parse_vec(expression, Flags.fixed ? DecScale : sig);
+	if (!(expr = xstrdup(expression)))
 		return NULL;
-	}
 	if (!null) {	// Check syntax once
-		if (chk_syntax(expression) != PASS || chk_parenth(expression) != PASS) {
-			free(expr);
+		if (staged(STG_SYNTAX, chk_syntax(expression)) != PASS ||
+			staged(STG_PARENTH, chk_parenth(expression)) != PASS) {
+			xfree(expr);
 			return NULL;
 		}
 	}
+	stage_begin(groups);
 	for (index = (size_t) null; index < strlen(expr); index++) {
 		chr = expr[index];
 		if (chr == ')') {
+			begin = trace_now();
+			before = Tracing ? strlen(expr) : 0;
+			hit = false;
 			par_high = index;
 			read_parenth = false;
 			expr[par_low] = (toast(expr, par_low)) ? '*' : ' ';
 			expr[par_high] = (toast(expr, par_high)) ? '*' : ' ';
 			if (par_low + 1 < par_high - 1) {	// Ensure parentheses are not empty
 				if (!(sub = popsub(expr, par_low + 1, par_high - 1))) {
-					free(expr);
+					xfree(expr);
 					return NULL;
 				}
-							if (!parse_sub(&sub)) {
-					free(expr);
-					free(sub);
-					return NULL;
+				if ((cached = getcache(sub))) {	// Shared subterm already evaluated
+					xfree(sub);
+					sub = cached;
+					hit = true;
+				} else {
+					if (!(cached = xstrdup(sub))) {
+						xfree(expr);
+						xfree(sub);
+						return NULL;
+					}
+					if (!parse_sub(&sub)) {
+						xfree(expr);
+						xfree(sub);
+						xfree(cached);
+						return NULL;
+					}
+					putcache(cached, sub);	// Failure only costs a future hit
+					xfree(cached);
 				}
 				if (!(expr = pushsub(expr, sub, par_low + 1, par_high - 1)))
 					return NULL;
 			}
-			if (null)
+			if (Tracing)
+				trace_step(hit ? "group (cached)" : "group", before, strlen(expr), begin);
+			if (null)	// Recorded once, by the outermost call
 				return expr;
 			index = 0;
 		} else if (chr == '(') {
 			if (read_parenth) {
 				sub = expr;
 				expr = parse(expr, sig, (void *) index);
-				free(sub);
+				xfree(sub);
 				if (!expr)
 					return NULL;
 				index = 0;
@@ -60,134 +96,103 @@ char *parse(const char *expression, unsigned sig, void *null) {
 			}
 		}
 	}
+	stage_end(STG_GROUPS, groups);
 	if (!parse_sub(&expr)) {
-		free(expr);
+		xfree(expr);
 		return NULL;
 	}
 	sub = expr;
-	expr = pprint(expr);
-	free(sub);
+	expr = staged(STG_PPRINT, pprint(expr));
+	xfree(sub);
 	if (!expr)
 		return NULL;
-	return roundnum(expr, sig);
+	if (Flags.fixed)	// Already exact, only needs every place of the scale
+		return staged(STG_ROUND, rounddec(expr));
+	return staged(STG_ROUND, roundnum(expr, sig));
 }
 
 char *parse_sub(char **expr_addr) {
-	char *expr = *expr_addr;	// Dynamic buffer
-	size_t ignore = 0;
+	unsigned present;	// Operators in expression, one bit each
 
-	while (true) {
-		ignore = strspn(expr, " ");
-		if (isparity(expr[ignore]))
-			ignore++;
-		if (ignore == strlen(expr) || strcspn(expr + ignore, ChrSets.opers) == strlen(expr + ignore))
-			break;
-		if (!(parse_oper(&expr, "++")))	return NULL;
-		if (!(parse_oper(&expr, "--")))	return NULL;
-		if (!(parse_oper(&expr, "!!")))	return NULL;
-		if (!(parse_oper(&expr,  "!")))	return NULL;
-		if (!(parse_oper(&expr,  "^")))	return NULL;
-		if (!(parse_oper(&expr,  "/")))	return NULL;
-		if (!(parse_oper(&expr,  "*")))	return NULL;
-		if (!(parse_oper(&expr,  "%")))	return NULL;
-		if (!(parse_oper(&expr,  "-")))	return NULL;
-		if (!(parse_oper(&expr,  "+")))	return NULL;
-	}
-	return (*expr_addr = expr);
+	while ((present = parse_round(*expr_addr)))
+		for (const struct Operator *oper = Opers; oper < Opers + NOPER; oper++)	// Only passes that can match
+			if (ispass(present, oper) && !staged(oper->stage, parse_oper(expr_addr, oper)))
+				return NULL;
+	return *expr_addr;
 }
 
-char *parse_oper(char **expr_addr, const char *oper) {
+unsigned parse_round(const char *expr) {
+	size_t ignore = strspn(expr, " ");
+	unsigned present;
+
+	if (isparity(expr[ignore]))
+		ignore++;
+	if (!(present = operset(expr + ignore)))
+		return 0;
+	if (ignore && isparity(expr[ignore - 1]))	// Sign may begin double operator
+		present |= 1u << (lexoper(expr + ignore - 1, 2) - Opers);
+	return present;
+}
+
+char *parse_oper(char **expr_addr, const struct Operator *oper) {
+	const char *symbol = oper->symbol;
 	char *sub, chr;
 	char *expr = *expr_addr;	// Dynamic buffer
-	int reqval;
 	size_t opernum;
 	ssize_t llim, rlim;	// Left- and right-hand limits of operation
 	double lval, rval;	// Left and right values of operation
-	double result;
-	size_t index;
+	double result, begin;
+	size_t index, before;
 
-	opernum = strlen(oper);
+	opernum = strlen(symbol);
 	for (size_t index = 0; index < strlen(expr); index++) {
 		chr = expr[index];
-		if (opernum == 1 ? chr == oper[0] : chr == oper[0] && expr[index + 1] == oper[0]) {
-			switch(oper[0]) {
-			case '^': case '*': case '/': case '%':
-				reqval = LEFT|RIGHT;
-				break;
-			case '+': case '-':
-				reqval = RIGHT;
-				break;
-			case '!':
-				reqval = opernum == 1 ? RIGHT: LEFT|RIGHT;
-			break;
-			}
-			lval = getval(expr, index, LEFT);
+		if (opernum == 1 ? chr == symbol[0] : chr == symbol[0] && expr[index + 1] == symbol[0]) {
+			begin = trace_now();
+			before = Tracing ? strlen(expr) : 0;
 			llim = getlim(expr, index, LEFT);
-			rval = getval(expr, opernum == 1 ? index : index + 1, RIGHT);
 			rlim = getlim(expr, opernum == 1 ? index : index + 1, RIGHT);
-			if (isequal(rval, FAIL) || isequal(lval, FAIL))
-				return NULL;
-			if (rlim == index || reqval & LEFT  && llim == index) {
+			if (!Flags.fixed) {
+				lval = getval(expr, index, LEFT);
+				rval = getval(expr, opernum == 1 ? index : index + 1, RIGHT);
+				if (isequal(rval, FAIL) || isequal(lval, FAIL))
+					return NULL;
+			}
+			if (rlim == index) {
 				setstat(ERR_MISSOPER);
 				return NULL;
 			}
-			switch(chr) {
-			case '^':				// Exponent
-				result = pow(lval, rval);
-				break;
-			case '*':				// Muliplication
-				result = lval * rval;
-				break;
-			case '/':				// Division
-				if (!rval) {
-					setstat(ERR_DIVZERO);
+			if (Flags.fixed) {	// Exact, read straight from operand text
+				if (!(sub = decoper(expr, index, symbol, &llim, rlim)))
 					return NULL;
-				}
-				result = lval / rval;
-				break;
-			case '%':				// Modulus
-				result = lval < 0 ? rval - lval : fmod(lval, rval);
-				break;
-			case '+':
-				if (opernum == 1) {	// Add
-					result = lval + rval;
-				} else {			// Increment
-					result = rval + 1;
-					llim = index;
-				}
-				break;
-			case '-':
-				if (opernum == 1) {	// Subtract/Unary minus
-					result = lval - rval;
-				} else {			// Decrement
-					result = rval - 1;
-					llim = index;
-				}
-				break;
-			case '!':				// Square root/Other root
-				if (opernum == 1) {
-					lval = 2;
-					llim = index;
-				}
-				if (rval < 0 && (intmax_t) lval % 2 == 0) {
-					setstat(ERR_IMAGINARY);
+			} else {
+				if (!oper->kernel(lval, rval, &result))
 					return NULL;
-				}
-				if (!lval) {
-					setstat(ERR_DIVZERO);
+				if (oper->arity == 1)	// No left-hand operand
+					llim = index;
+				if (!(sub = staged(STG_DTOS, dtos(result, MaxDec))))
 					return NULL;
-				}
-				result = rval < 0 ? -pow(-rval, 1 / lval) : pow(rval, 1 / lval);
-				break;
 			}
-			if (!(sub = dtos(result, MaxDec)))
-				return NULL;
-			if (!(expr = pushsub(expr, sub, llim, rlim)))
-				return NULL;
+			if (!(*expr_addr = expr = pushsub(expr, sub, llim, rlim)))
+				return NULL;	// Buffer was freed, caller must not free it again
+			if (Tracing && Flags.fixed)
+				trace_step(symbol, before, strlen(expr), begin);
+			else if (Tracing)
+				trace_oper(symbol, lval, rval, result, before, strlen(expr), begin);
 			index = strspn(expr, " ");
 			if (isparity(expr[index]))
 				index++;
 		}
 	}
 	return (*expr_addr = expr);
+}
+
+bool calc(const char *oper, double lval, double rval, double *result) {
+	const struct Operator *op = lexoper(oper, strlen(oper));
+
+	if (!op || op->symbol[1] != oper[1]) {	// Unknown, or trailing characters
+		setstat(ERR_INTERNAL);
+		return false;
+	}
+	return op->kernel(lval, rval, result);
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #ifndef PARSE_H
 #define PARSE_H
 
+#include <stdbool.h>	// bool
+#include "global.h"		// attribute()
+#include "oper.h"		// struct Operator
+
 /* Evaluates mathemetical expression
  * Returns string representation of result
  * On success, result must be freed
@@ -14,10 +18,24 @@ attribute(__warn_unused_result__, __nonnull__(1));
 extern char *parse_sub(char **expr_addr)
 attribute(__nonnull__(1));
 
+/* Returns operators the next round of passes of parse_sub() looks for, one bit per index of Opers
+ * Returns 0 once expression is a single value */
+extern unsigned parse_round(const char *expr)
+attribute(__nonnull__(1));
+
+/* Returns true if round of given operators makes a pass for operator */
+#define ispass(present, oper)	((present) & 1u << ((oper) - Opers) || (oper)->flags & OPF_SIGN)
+
 /* Evaluates given operation in mathematical expression
  * Ignores parentheses and syntax errors
  * Returns NULL on failure */
-extern char *parse_oper(char **expr_addr, const char *oper)
-attribute(__nonnull__(1));
+extern char *parse_oper(char **expr_addr, const struct Operator *oper)
+attribute(__nonnull__(1, 2));
+
+/* Applies operator, as written in expression, to double operands, through its kernel in the operator table
+ * Increment, decrement and square root ignore the left-hand value
+ * Returns false on failure */
+extern bool calc(const char *oper, double lval, double rval, double *result)
+attribute(__nonnull__(1, 4));
 
 #endif // #ifndef PARSE_H
\ No newline at end of file
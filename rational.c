@@ -0,0 +1,612 @@
+#include <ctype.h>
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "global.h"
+#include "mem.h"
+#include "oper.h"
+#include "parse.h"
+#include "rational.h"
+#include "status.h"
+#include "util.h"
+
+#define RAT_DEPTH	256	// Deepest accepted nesting of parentheses
+#define RAT_DIGITS	39	// Most digits of whole part
+#define RAT_MAXDEN	62	// Bits of denominators of inexact results, keeping them within 64 bits
+#define RAT_FLUSH	4096	// Characters streamed between flushes
+#define RAT_DBLLEN	32		// Characters of result too large for a fraction, printed as a double
+
+/* Returns true if integer fits in 64 bits */
+#define fits64(x)	((x) == (int64_t) (x))
+
+typedef unsigned __int128 u128;
+
+struct Reader {
+	const char *expr, *pos;
+	unsigned depth;	// Open parentheses
+	bool inexact;	// Some operation went through doubles
+};
+
+/* Value of subexpression, kept as a double where no fraction of 128-bit integers holds it */
+struct Term {
+	struct Ratio rat;
+	double dbl;
+	bool exact;		// Held in rat, not dbl?
+};
+
+/* Destination of decimal digits */
+struct Sink {
+	FILE *file;		// Written as digits are found, or NULL
+	char *str;		// Otherwise appended to
+	size_t len;		// Characters written
+};
+
+/* Digits of decimal expansion not yet written */
+struct Expansion {
+	u128 whole;
+	bool neg, begun;	// Whole part written
+	int held;			// Digit before held nines, or -1
+	unsigned long nines, zeros;	// Held runs, never both
+};
+
+static const struct Ratio Zero = {0, 1}, One = {1, 1};
+static const struct Term Nil = {{0, 1}, 0, true};	// Left operand of unary operators
+
+/* Returns number of trailing zero bits of nonzero integer */
+static unsigned ctz(u128 x) {
+	return (uint64_t) x ? __builtin_ctzll(x) : 64 + __builtin_ctzll(x >> 64);
+}
+
+/* Returns greatest common divisor by binary GCD, in 64 bits once both fit */
+static u128 gcd(u128 a, u128 b) {
+	unsigned shift;
+	uint64_t a64, b64, swap;
+	u128 swap128;
+
+	if (!a || !b)
+		return a | b;
+	shift = ctz(a | b);
+	a >>= ctz(a);
+	do {
+		b >>= ctz(b);
+		if (!(a >> 64) && !(b >> 64))
+			break;
+		if (a > b) {
+			swap128 = a;
+			a = b;
+			b = swap128;
+		}
+		b -= a;
+	} while (b);
+	if (!b)
+		return a << shift;
+	for (a64 = a, b64 = b; ; ) {	// Same steps, narrower
+		if (a64 > b64) {
+			swap = a64;
+			a64 = b64;
+			b64 = swap;
+		}
+		if (!(b64 -= a64))
+			break;
+		b64 >>= __builtin_ctzll(b64);
+	}
+	return (u128) a64 << shift;
+}
+
+/* Puts fraction in lowest terms */
+static void reduce(struct Ratio *x) {
+	u128 div = gcd(x->num < 0 ? -(u128) x->num : (u128) x->num, x->den);
+
+	if (div > 1) {
+		x->num /= (__int128) div;
+		x->den /= (__int128) div;
+	}
+}
+
+/* Reduces fraction only once it has outgrown 64 bits, so that the next operation can stay in them */
+static void tidy(struct Ratio *x) {
+	if (!fits64(x->num) || !fits64(x->den))
+		reduce(x);
+}
+
+/* Multiplies in 64 bits if possible, otherwise in 128
+ * Returns false on overflow */
+static bool mul(__int128 a, __int128 b, __int128 *result) {
+	int64_t small;
+
+	if (fits64(a) && fits64(b) && !__builtin_mul_overflow((int64_t) a, (int64_t) b, &small)) {
+		*result = small;
+		return true;
+	}
+	return !__builtin_mul_overflow(a, b, result);
+}
+
+static bool ratadd(struct Ratio lval, struct Ratio rval, struct Ratio *result) {
+	__int128 lnum, rnum;
+
+	if (lval.den == rval.den) {	// Common in sums of whole numbers
+		result->den = lval.den;
+		return !__builtin_add_overflow(lval.num, rval.num, &result->num);
+	}
+	return mul(lval.num, rval.den, &lnum) && mul(rval.num, lval.den, &rnum) &&
+		   mul(lval.den, rval.den, &result->den) && !__builtin_add_overflow(lnum, rnum, &result->num);
+}
+
+static bool ratmul(struct Ratio lval, struct Ratio rval, struct Ratio *result) {
+	return mul(lval.num, rval.num, &result->num) && mul(lval.den, rval.den, &result->den);
+}
+
+/* Divides by nonzero fraction */
+static bool ratdiv(struct Ratio lval, struct Ratio rval, struct Ratio *result) {
+	if (!ratmul(lval, (struct Ratio) {rval.den, rval.num}, result))
+		return false;
+	if (result->den < 0)
+		return !__builtin_sub_overflow(0, result->num, &result->num) && !__builtin_sub_overflow(0, result->den, &result->den);
+	return true;
+}
+
+/* Modulus as calc() takes it, truncating quotient as fmod() does */
+static bool ratmod(struct Ratio lval, struct Ratio rval, struct Ratio *result) {
+	struct Ratio quot;
+
+	if (lval.num < 0)
+		return !__builtin_sub_overflow(0, lval.num, &lval.num) && ratadd(rval, lval, result);
+	if (!ratdiv(lval, rval, &quot) || !mul(quot.num / quot.den, rval.num, &quot.num))
+		return false;
+	quot.num = -quot.num, quot.den = rval.den;
+	return ratadd(lval, quot, result);
+}
+
+/* Raises fraction in lowest terms to whole power, by squaring */
+static bool ratpow(struct Ratio base, int64_t exp, struct Ratio *result) {
+	*result = One;
+	if (exp < 0) {
+		base = base.num < 0 ? (struct Ratio) {-base.den, -base.num} : (struct Ratio) {base.den, base.num};
+		exp = -exp;
+	}
+	for (; exp; exp >>= 1) {	// Powers of reduced fractions are reduced
+		if (exp & 1 && !ratmul(*result, base, result))
+			return false;
+		if (exp > 1 && !ratmul(base, base, &base))
+			return false;
+	}
+	return true;
+}
+
+static double todbl(struct Term x) {
+	return x.exact ? (double) x.rat.num / (double) x.rat.den : x.dbl;
+}
+
+/* Returns exact fraction of double, or nearest one of denominator under 2^RAT_MAXDEN
+ * Returns false if double is not finite, or too large for a fraction */
+static bool dtorat(double x, struct Ratio *result) {
+	int exp;
+	int64_t mant;
+
+	if (!isfinite(x))	// Before conversion to integer, which is undefined for these
+		return false;
+	mant = ldexp(frexp(x, &exp), DBL_MANT_DIG);	// x = mant * 2^exp
+	exp -= DBL_MANT_DIG;
+	if (exp > 126 - DBL_MANT_DIG)
+		return false;
+	if (exp < -RAT_MAXDEN) {	// Inexact anyway
+		mant = llround(ldexp(mant, exp + RAT_MAXDEN));
+		exp = -RAT_MAXDEN;
+	}
+	*result = exp < 0 ? (struct Ratio) {mant, (__int128) 1 << -exp} : (struct Ratio) {(__int128) mant * ((__int128) 1 << exp), 1};
+	reduce(result);
+	return true;
+}
+
+/* Sets term to double, as a fraction if that holds it exactly
+ * Returns false if double is not finite */
+static bool fromdbl(double x, struct Term *val) {
+	int exp;
+
+	if (isnan(x)) {
+		setstat(ERR_IMAGINARY);
+		return false;
+	}
+	if (isinf(x)) {
+		setstat(ERR_OVERFLOW);
+		return false;
+	}
+	*val = (struct Term) {Zero, x, false};
+	frexp(x, &exp);
+	if (exp - DBL_MANT_DIG >= -RAT_MAXDEN)	// Otherwise fraction would be rounded
+		val->exact = dtorat(x, &val->rat);
+	return true;
+}
+
+/* Applies operator to doubles, as calc() does
+ * Returns false on failure */
+static bool dblcalc(struct Reader *rd, const struct Operator *oper, struct Term lval, struct Term rval, struct Term *result) {
+	double dbl;
+
+	rd->inexact = true;
+	return calc(oper->symbol, todbl(lval), todbl(rval), &dbl) && fromdbl(dbl, result);
+}
+
+/* Applies operator to fractions
+ * Results that overflow are retried once with operands in lowest terms, then with doubles if some operation already was
+ * Returns false on failure */
+static bool ratcalc(struct Reader *rd, const struct Operator *oper, struct Term lval, struct Term rval, struct Term *result) {
+	enum OperatorId id = oper - Opers;
+	struct Ratio left = lval.rat, right = rval.rat;
+	bool exact;
+
+	if ((id == OP_DIV || id == OP_MOD) && (rval.exact ? !right.num : !rval.dbl)) {
+		setstat(ERR_DIVZERO);
+		return false;
+	}
+	if (!lval.exact || !rval.exact)
+		return dblcalc(rd, oper, lval, rval, result);
+	if (id == OP_EXP) {
+		reduce(&right);
+		if (right.den != 1)	// Fractional power
+			return dblcalc(rd, oper, lval, rval, result);
+		if (!left.num && right.num < 0) {
+			setstat(ERR_DIVZERO);
+			return false;
+		}
+		reduce(&left);
+		if (right.num > RAT_MAXPOW || right.num < -RAT_MAXPOW) {
+			if (left.den != 1 || left.num > 1 || left.num < -1)
+				goto overflow;
+			right.num = right.num % 2 + (right.num < 0 ? -2 : 2);	// Same sign and parity, so same power
+		}
+	}
+	if (id == OP_SUB && __builtin_sub_overflow(0, right.num, &right.num))
+		goto overflow;
+	*result = Nil;
+	for (unsigned attempt = 0; attempt < 2; attempt++) {
+		switch (id) {
+		case OP_ADD: case OP_SUB:	exact = ratadd(left, right, &result->rat);					break;
+		case OP_INCR:				exact = ratadd(right, One, &result->rat);					break;
+		case OP_DECR:				exact = ratadd(right, (struct Ratio) {-1, 1}, &result->rat);	break;
+		case OP_MUL:				exact = ratmul(left, right, &result->rat);					break;
+		case OP_DIV:				exact = ratdiv(left, right, &result->rat);					break;
+		case OP_MOD:				exact = ratmod(left, right, &result->rat);					break;
+		case OP_EXP:				exact = ratpow(left, right.num, &result->rat);				break;
+		default:	// Roots are irrational
+			return dblcalc(rd, oper, lval, rval, result);
+		}
+		if (exact) {
+			tidy(&result->rat);
+			return true;
+		}
+		reduce(&left);
+		reduce(&right);
+	}
+overflow:	// Too large for 128 bits even in lowest terms
+	if (rd->inexact)	// Approximate anyway
+		return dblcalc(rd, oper, lval, rval, result);
+	setstat(ERR_OVERFLOW);
+	return false;
+}
+
+static void skip(struct Reader *rd) {
+	while (*rd->pos == ' ')	rd->pos++;
+}
+
+/* Sets syntax error at current position
+ * If input has ended, sets it at given opening parenthesis, or else at last character */
+static void syntax(const struct Reader *rd, const char *open) {
+	size_t pos = (*rd->pos ? rd->pos : open ? open : rd->pos - (rd->pos > rd->expr)) - rd->expr;
+
+	setstat(ERR_SYNTAX);
+	setspan(rd->expr, pos, toklen(rd->expr, pos));
+}
+
+/* Appends decimal digit to integer
+ * Returns false on overflow */
+static bool putdigit(__int128 *x, char digit) {
+	return mul(*x, 10, x) && !__builtin_add_overflow(*x, digit - '0', x);
+}
+
+/* Evaluates number exactly, such as 1.25 or 2E-3
+ * Returns false on failure, including numbers with too many digits for 128 bits */
+static bool number(struct Reader *rd, struct Term *val) {
+	struct Ratio *rat = &val->rat;
+	bool point = false, digits = false, neg = false, over = false;
+	__int128 exp = 0;
+
+	*val = Nil;
+	for (; isdigit(*rd->pos) || *rd->pos == '.' && !point; rd->pos++) {
+		if (*rd->pos == '.')
+			point = true;
+		else {
+			over = over || !putdigit(&rat->num, *rd->pos) || point && !mul(rat->den, 10, &rat->den);
+			digits = true;
+		}
+	}
+	if (!digits || *rd->pos == '.') {	// Such as 1.2.3
+		syntax(rd, NULL);
+		return false;
+	}
+	if (*rd->pos == 'E') {
+		neg = rd->pos[1] == '-';
+		if (!isdigit(rd->pos[1 + isparity(rd->pos[1])])) {
+			syntax(rd, NULL);
+			return false;
+		}
+		rd->pos += 1 + isparity(rd->pos[1]);
+		for (; isdigit(*rd->pos); rd->pos++)
+			over = over || !putdigit(&exp, *rd->pos) || exp > RAT_DIGITS * 2;
+		for (; !over && exp; exp--)
+			over = !mul(neg ? rat->den : rat->num, 10, neg ? &rat->den : &rat->num);
+	}
+	if (over) {
+		setstat(ERR_OVERFLOW);
+		return false;
+	}
+	tidy(rat);
+	return true;
+}
+
+/* Consumes operator if it is next, but not the first half of a double operator */
+static bool accept(struct Reader *rd, const char *oper) {
+	size_t len = strlen(oper);
+
+	skip(rd);
+	if (strncmp(rd->pos, oper, len))
+		return false;
+	if (len == 1 && rd->pos[1] == oper[0] && ischr(oper[0], CHR_DOUBL))
+		return false;
+	rd->pos += len;
+	return true;
+}
+
+/* Returns true if next token multiplies by juxtaposition, x(y) */
+static bool implicit(struct Reader *rd) {
+	skip(rd);
+	return *rd->pos == '(' || isdigit(*rd->pos) || *rd->pos == '.';
+}
+
+static bool binary(struct Reader *rd, unsigned prec, struct Term *val);
+
+/* Evaluates number, group, or unary operation on either */
+static bool unary(struct Reader *rd, struct Term *val) {
+	const struct Operator *oper;
+	const char *open;
+	struct Term arg;
+
+	skip(rd);
+	if (!*rd->pos) {
+		setstat(ERR_MISSOPER);
+		return false;
+	}
+	if ((oper = lexoper(rd->pos, 2)) && oper->arity == 1) {
+		rd->pos += strlen(oper->symbol);
+		return unary(rd, &arg) && ratcalc(rd, oper, Nil, arg, val);
+	}
+	if (accept(rd, "+"))	// Sign
+		return unary(rd, val);
+	if (accept(rd, "-"))
+		return unary(rd, &arg) && ratcalc(rd, &Opers[OP_SUB], Nil, arg, val);
+	if (isdigit(*rd->pos) || *rd->pos == '.')
+		return number(rd, val);
+	if (*rd->pos == '(') {
+		open = rd->pos++;
+		if (++rd->depth > RAT_DEPTH) {
+			setstat(ERR_INPUTSIZE);
+			return false;
+		}
+		if (!binary(rd, PREC_MIN, val))
+			return false;
+		if (!accept(rd, ")")) {
+			syntax(rd, open);
+			return false;
+		}
+		rd->depth--;
+		return true;
+	}
+	if (*rd->pos == ')' || ischr(*rd->pos, CHR_OPER)) {
+		setstat(ERR_MISSOPER);
+		return false;
+	}
+	syntax(rd, NULL);
+	return false;
+}
+
+/* Consumes binary operator of given precedence if it is next, including multiplication by juxtaposition
+ * Returns NULL otherwise */
+static const struct Operator *match(struct Reader *rd, unsigned prec) {
+	const struct Operator *oper;
+
+	skip(rd);
+	if ((oper = lexoper(rd->pos, 2)) && oper->arity == 2 && oper->prec == prec) {
+		rd->pos += strlen(oper->symbol);
+		return oper;
+	}
+	if (prec == Opers[OP_MUL].prec && implicit(rd))
+		return &Opers[OP_MUL];
+	return NULL;
+}
+
+/* Evaluates operations of given precedence and higher */
+static bool binary(struct Reader *rd, unsigned prec, struct Term *val) {
+	const struct Operator *oper;
+	struct Term rval;
+
+	if (prec > PREC_BINARY)
+		return unary(rd, val);
+	if (!binary(rd, prec + 1, val))
+		return false;
+	while ((oper = match(rd, prec)))
+		if (!binary(rd, prec + (oper->assoc == LEFT), &rval) || !ratcalc(rd, oper, *val, rval, val))
+			return false;
+	return true;
+}
+
+/* Writes characters to sink, flushing file every RAT_FLUSH of them so that long expansions appear as they are found */
+static void put(struct Sink *sink, char chr, size_t count) {
+	if (!sink->file) {
+		memset(sink->str + sink->len, chr, count);
+		sink->len += count;
+		return;
+	}
+	for (; count; count--) {
+		putc(chr, sink->file);
+		if (!(++sink->len % RAT_FLUSH))
+			fflush(sink->file);
+	}
+}
+
+/* Writes whole part, and point if digits follow */
+static void begin(struct Sink *sink, struct Expansion *pend, bool point) {
+	char digits[RAT_DIGITS];
+	size_t len = 0;
+
+	if (pend->neg && (point || pend->whole))	// Never -0
+		put(sink, '-', 1);
+	do {
+		digits[len++] = '0' + pend->whole % 10;
+	} while (pend->whole /= 10);
+	while (len)
+		put(sink, digits[--len], 1);
+	if (point)
+		put(sink, '.', 1);
+	pend->begun = true;
+}
+
+/* Writes held digits, once later digits show they will be neither carried into nor trailing zeros */
+static void release(struct Sink *sink, struct Expansion *pend) {
+	if (!pend->begun)
+		begin(sink, pend, true);
+	if (pend->held >= 0)
+		put(sink, '0' + pend->held, 1);
+	put(sink, '9', pend->nines);
+	put(sink, '0', pend->zeros);
+	pend->held = -1;
+	pend->nines = pend->zeros = 0;
+}
+
+/* Writes fraction to given decimal places by long division, rounded half away from zero, without trailing zeros
+ * Only the last digit other than nine with the nines after it, or a run of zeros, is held back at any time,
+ * so time grows with places written and memory does not */
+static void expand(struct Ratio x, unsigned sig, struct Sink *sink) {
+	struct Expansion pend = {.neg = x.num < 0, .held = -1};
+	u128 den = x.den, rem = x.num < 0 ? -(u128) x.num : (u128) x.num;
+	uint64_t small;
+	unsigned digit;
+
+	pend.whole = rem / den;
+	rem %= den;
+	for (unsigned place = 0; place < sig && rem; place++) {
+		if (den >> 60) {
+			rem *= 10;
+			digit = rem / den;
+			rem %= den;
+		} else {	// Remainder times ten fits in 64 bits
+			small = (uint64_t) rem * 10;
+			digit = small / (uint64_t) den;
+			rem = small % (uint64_t) den;
+		}
+		if (digit == 9) {
+			if (pend.zeros) {	// Last zero takes any carry
+				pend.zeros--;
+				release(sink, &pend);
+				pend.held = 0;
+			}
+			pend.nines++;
+		} else if (digit) {
+			release(sink, &pend);
+			pend.held = digit;
+		} else if (pend.zeros)
+			pend.zeros++;
+		else {
+			if (pend.held >= 0 || pend.nines)
+				release(sink, &pend);
+			pend.zeros = 1;
+		}
+	}
+	if (rem && rem >= den - rem) {	// Half or more remains, round up
+		pend.nines = 0;
+		if (pend.zeros) {
+			pend.zeros--;
+			release(sink, &pend);
+			put(sink, '1', 1);
+		} else if (pend.held >= 0) {
+			pend.held++;
+			release(sink, &pend);
+		} else {
+			pend.whole++;
+			begin(sink, &pend, false);
+		}
+	} else if (pend.held >= 0 || pend.nines)
+		release(sink, &pend);
+	else if (!pend.begun)	// Trailing zeros are dropped
+		begin(sink, &pend, false);
+}
+
+/* Evaluates expression to fraction, failing if it went through doubles and more places than MaxDec are asked for
+ * Results too large for a fraction are left as doubles
+ * Returns false on failure */
+static bool evaluate(const char *expr, struct Term *val, unsigned sig) {
+	struct Reader rd = {expr, expr, 0, false};
+
+	if (!binary(&rd, PREC_MIN, val))
+		return false;
+	skip(&rd);
+	if (*rd.pos) {
+		syntax(&rd, NULL);
+		return false;
+	}
+	if (rd.inexact && sig > MaxDec) {	// Further digits would be those of a double
+		setstat(ERR_INVDEC);
+		return false;
+	}
+	if (!val->exact && !(val->exact = dtorat(val->dbl, &val->rat)))
+		return true;
+	reduce(&val->rat);
+	if ((u128) val->rat.den > ~(u128) 0 / 10) {	// Long division would overflow
+		setstat(ERR_OVERFLOW);
+		return false;
+	}
+	return true;
+}
+
+char *parse_rat(const char *expr, unsigned sig) {
+	struct Term val;
+	char *str;
+
+	if (!evaluate(expr, &val, sig))
+		return NULL;
+	if (val.exact)
+		return rattos(val.rat, sig);
+	if ((str = (char *) xmalloc(RAT_DBLLEN * sizeof(char))))
+		snprintf(str, RAT_DBLLEN, "%.*g", DBL_DIG, val.dbl);
+	return str;
+}
+
+bool print_rat(const char *expr, unsigned sig, FILE *file) {
+	struct Term val;
+	struct Sink sink = {file, NULL, 0};
+
+	if (!evaluate(expr, &val, sig))
+		return false;
+	if (val.exact)
+		expand(val.rat, sig, &sink);
+	else
+		fprintf(file, "%.*g", DBL_DIG, val.dbl);
+	return !ferror(file);
+}
+
+char *rattos(struct Ratio x, unsigned sig) {
+	struct Sink sink = {NULL, NULL, 0};
+
+	reduce(&x);
+	if ((u128) x.den > ~(u128) 0 / 10) {	// Long division would overflow
+		setstat(ERR_OVERFLOW);
+		return NULL;
+	}
+	if (!(sink.str = (char *) xmalloc((RAT_DIGITS + 3 /* Sign, point, null character */ + (size_t) sig) * sizeof(char))))
+		return NULL;
+	expand(x, sig, &sink);
+	sink.str[sink.len] = '\0';
+	return sink.str;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef RATIONAL_H
+#define RATIONAL_H
+
+#include <stdbool.h>	// bool
+#include <stdio.h>		// FILE
+#include "global.h"		// attribute()
+
+/* Exact rational arithmetic, used in place of doubles when Flags.rational is set
+ * Values are fractions of 128-bit integers, worked on in 64 bits while they fit
+ * Fractions are only reduced when they outgrow 64 bits, or an operation would overflow
+ * +, -, *, /, %, ++, -- and whole powers are exact, other operations go through doubles
+ * Numbers and results that 128 bits cannot hold are too large, rather than approximated by doubles, unless already inexact
+ * Results of other operations too large for a fraction are printed in scientific notation
+ * Exact results may be written to any number of places, up to RAT_MAXDEC, digit by digit, others to at most MaxDec */
+
+#define RAT_MAXPOW	1024	// Largest whole exponent of values other than 0 and ±1
+#define RAT_MAXDEC	1000000	// Most decimal places, where -d allows more than MaxDec
+
+/* Fraction, not necessarily in lowest terms */
+struct Ratio {
+	__int128 num;
+	__int128 den;	// Always positive
+};
+
+/* Evaluates expression exactly, converting to decimal only once
+ * Returns string of result to given decimal places, without trailing zeros
+ * On success, result must be freed
+ * Returns NULL on failure */
+extern char *parse_rat(const char *expr, unsigned sig)
+attribute(__warn_unused_result__, __nonnull__(1));
+
+/* Evaluates expression exactly, writing result to file to given decimal places as its digits are found
+ * Fails for results that went through doubles, given more than MaxDec places
+ * Nothing is written on failure
+ * Returns false on failure */
+extern bool print_rat(const char *expr, unsigned sig, FILE *file)
+attribute(__nonnull__(1, 3));
+
+/* Returns null-terminated, malloc'd string of fraction to given decimal places, rounded half away from zero
+ * On success, result must be freed
+ * Returns NULL on failure */
+extern char *rattos(struct Ratio x, unsigned sig)
+attribute(__warn_unused_result__);
+
+#endif // #ifndef RATIONAL_H
\ No newline at end of file
@@ -0,0 +1,421 @@
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "decimal.h"
+#include "global.h"
+#include "mem.h"
+#include "oper.h"
+#include "parse.h"
+#include "record.h"
+#include "status.h"
+#include "util.h"
+
+#define HEADER_REQ	4		// Length
+#define RES_MAX		19		// Status, tag, int128, places
+#define READ_SIZE	65536	// Bytes requested from input at once
+#define MAX_COEF	18		// Most digits of a decimal coefficient
+
+/* Number in either representation */
+union Value {
+	double dbl;
+	dec_t dec;
+};
+
+struct Reader {
+	const unsigned char *pos, *end;
+	unsigned depth;	// Open parentheses
+};
+
+struct Buffer {
+	unsigned char *data;
+	size_t len, cap;
+};
+
+static void putu32(unsigned char *dest, uint32_t x) {
+	dest[0] = x >> 24, dest[1] = x >> 16, dest[2] = x >> 8, dest[3] = x;
+}
+
+static uint32_t getu32(const unsigned char *src) {
+	return (uint32_t) src[0] << 24 | (uint32_t) src[1] << 16 | (uint32_t) src[2] << 8 | src[3];
+}
+
+static void putu64(unsigned char *dest, uint64_t x) {
+	putu32(dest, x >> 32);
+	putu32(dest + 4, x);
+}
+
+static uint64_t getu64(const unsigned char *src) {
+	return (uint64_t) getu32(src) << 32 | getu32(src + 4);
+}
+
+/* Ensures room for given number of bytes past end of buffer
+ * Returns false on failure */
+static bool reserve(struct Buffer *buf, size_t size) {
+	unsigned char *swap;
+	size_t cap = buf->cap ? buf->cap : 256;
+
+	if (buf->len + size <= buf->cap)
+		return true;
+	while (cap < buf->len + size)	cap *= 2;
+	if (!(swap = realloc(buf->data, cap))) {
+		setstat(ERR_INTERNAL);
+		return false;
+	}
+	buf->data = swap;
+	buf->cap = cap;
+	return true;
+}
+
+static bool apply(const char *oper, union Value lval, union Value rval, union Value *result) {
+	if (Flags.fixed)
+		return deccalc(oper, lval.dec, rval.dec, &result->dec);
+	return calc(oper, lval.dbl, rval.dbl, &result->dbl);
+}
+
+/* Consumes operator if it is next, but not the first half of a double operator */
+static bool accept(struct Reader *rd, const char *oper) {
+	size_t len = strlen(oper);
+
+	if (rd->end - rd->pos < len || memcmp(rd->pos, oper, len))
+		return false;
+	if (len == 1 && rd->end - rd->pos > 1 && rd->pos[1] == oper[0] && ischr(oper[0], CHR_DOUBL))
+		return false;
+	rd->pos += len;
+	return true;
+}
+
+/* Returns true if next token multiplies by juxtaposition, x(y) */
+static bool implicit(const struct Reader *rd) {
+	return rd->pos < rd->end && (*rd->pos == '(' || *rd->pos == REC_DOUBLE || *rd->pos == REC_DECIMAL);
+}
+
+/* Consumes binary operator of given precedence if it is next, including multiplication by juxtaposition
+ * Returns NULL otherwise */
+static const struct Operator *nextoper(struct Reader *rd, unsigned prec) {
+	const struct Operator *oper = lexoper((const char *) rd->pos, rd->end - rd->pos);
+
+	if (oper && oper->arity == 2 && oper->prec == prec) {
+		rd->pos += strlen(oper->symbol);
+		return oper;
+	}
+	if (prec == Opers[OP_MUL].prec && implicit(rd))
+		return &Opers[OP_MUL];
+	return NULL;
+}
+
+static bool binary(struct Reader *rd, unsigned prec, union Value *val);
+
+/* Evaluates number, group, or unary operation on either */
+static bool unary(struct Reader *rd, union Value *val) {
+	static const union Value zero;
+	const struct Operator *oper;
+	union Value arg;
+	uint64_t bits;
+	double dbl;
+
+	if (rd->pos == rd->end) {
+		setstat(ERR_MISSOPER);
+		return false;
+	}
+	if ((oper = lexoper((const char *) rd->pos, rd->end - rd->pos)) && oper->arity == 1) {
+		rd->pos += strlen(oper->symbol);
+		return unary(rd, &arg) && apply(oper->symbol, zero, arg, val);
+	}
+	if (accept(rd, "+"))	// Sign
+		return unary(rd, val);
+	if (accept(rd, "-"))
+		return unary(rd, &arg) && apply("-", zero, arg, val);
+	switch (*rd->pos++) {
+	case REC_DOUBLE:
+		if (rd->end - rd->pos < 8)
+			break;
+		bits = getu64(rd->pos);
+		memcpy(&dbl, &bits, sizeof(dbl));
+		rd->pos += 8;
+		if (Flags.fixed)
+			return dtodec(dbl, &val->dec);
+		val->dbl = dbl;
+		return true;
+	case REC_DECIMAL:
+		if (rd->end - rd->pos < 9)
+			break;
+		bits = getu64(rd->pos);
+		rd->pos += 9;
+		if (Flags.fixed)
+			return scaledec((int64_t) bits, rd->pos[-1], &val->dec);
+		val->dbl = (int64_t) bits / pow(10, rd->pos[-1]);
+		return true;
+	case '(':
+		if (++rd->depth > REC_DEPTH) {
+			setstat(ERR_INPUTSIZE);
+			return false;
+		}
+		if (!binary(rd, PREC_MIN, val))
+			return false;
+		if (!accept(rd, ")"))
+			break;
+		rd->depth--;
+		return true;
+	default:
+		if (ischr(rd->pos[-1], CHR_OPER)) {
+			setstat(ERR_MISSOPER);
+			return false;
+		}
+	}
+	setstat(ERR_SYNTAX);
+	return false;
+}
+
+/* Evaluates operations of given precedence and higher */
+static bool binary(struct Reader *rd, unsigned prec, union Value *val) {
+	const struct Operator *oper;
+	union Value rval;
+
+	if (prec > PREC_BINARY)
+		return unary(rd, val);
+	if (!binary(rd, prec + 1, val))
+		return false;
+	while ((oper = nextoper(rd, prec)))
+		if (!binary(rd, prec + (oper->assoc == LEFT), &rval) || !apply(oper->symbol, *val, rval, val))
+			return false;
+	return true;
+}
+
+/* Evaluates tokens of request
+ * Returns false on failure */
+static bool receval(const unsigned char *tok, size_t len, union Value *val) {
+	struct Reader rd = {tok, tok + len, 0};
+
+	if (!binary(&rd, PREC_MIN, val))
+		return false;
+	if (rd.pos != rd.end) {
+		setstat(ERR_SYNTAX);
+		return false;
+	}
+	if (!Flags.fixed && isnan(val->dbl)) {
+		setstat(ERR_IMAGINARY);
+		return false;
+	}
+	if (!Flags.fixed && isinf(val->dbl)) {
+		setstat(ERR_OVERFLOW);
+		return false;
+	}
+	return true;
+}
+
+/* Appends response record to buffer
+ * Returns false on failure */
+static bool putres(struct Buffer *buf, int stat, const union Value *val) {
+	uint64_t bits;
+
+	if (!reserve(buf, RES_MAX))
+		return false;
+	buf->data[buf->len++] = stat;
+	if (stat)
+		return true;
+	if (Flags.fixed) {
+		buf->data[buf->len++] = REC_DECIMAL;
+		putu64(buf->data + buf->len, (unsigned __int128) val->dec >> 64);
+		putu64(buf->data + buf->len + 8, val->dec);
+		buf->data[buf->len + 16] = DecScale;
+		buf->len += 17;
+	} else {
+		buf->data[buf->len++] = REC_DOUBLE;
+		memcpy(&bits, &val->dbl, sizeof(bits));
+		putu64(buf->data + buf->len, bits);
+		buf->len += 8;
+	}
+	return true;
+}
+
+/* Writes all of buffer, then empties it
+ * Returns false on failure */
+static bool drain(int fd, struct Buffer *buf) {
+	ssize_t sent;
+
+	for (size_t off = 0; off < buf->len; off += sent) {
+		if ((sent = write(fd, buf->data + off, buf->len - off)) < 0) {
+			if (errno == EINTR) {
+				sent = 0;
+				continue;
+			}
+			setstat(ERR_INTERNAL);
+			return false;
+		}
+	}
+	buf->len = 0;
+	return true;
+}
+
+bool recserve(int in, int out) {
+	struct Buffer req = {NULL, 0, 0}, res = {NULL, 0, 0};
+	size_t off = 0;	// Start of next request
+	bool ok = false;
+	union Value val;
+	uint32_t len;
+	ssize_t got;
+
+	while (true) {
+		if (req.len - off >= HEADER_REQ) {
+			if ((len = getu32(req.data + off)) > REC_MAX) {
+				setstat(ERR_INPUTSIZE);
+				break;
+			}
+			if (req.len - off - HEADER_REQ >= len) {	// Complete request
+				ErrStat = 0;
+				if (!putres(&res, receval(req.data + off + HEADER_REQ, len, &val) ? 0 : ErrStat, &val))
+					break;
+				off += HEADER_REQ + len;
+				continue;
+			}
+		}
+		if (!drain(out, &res))	// Answer everything before waiting for more
+			break;
+		if (off) {	// Keep partial request
+			memmove(req.data, req.data + off, req.len - off);
+			req.len -= off;
+			off = 0;
+		}
+		if (!reserve(&req, READ_SIZE))
+			break;
+		if ((got = read(in, req.data + req.len, READ_SIZE)) < 0) {
+			if (errno == EINTR)
+				continue;
+			setstat(ERR_INTERNAL);
+			break;
+		}
+		if (!got) {	// End of input, a partial request is dropped
+			ok = true;
+			break;
+		}
+		req.len += got;
+	}
+	ErrStat = ok ? 0 : ErrStat;
+	free(req.data);
+	free(res.data);
+	return ok;
+}
+
+/* Appends number starting at given character as a token, moving past it */
+static bool putnum(struct Buffer *rec, const char **str) {
+	const char *num = *str;
+	size_t digits = strspn(num, "0123456789."), points = 0, places = 0;
+	uint64_t bits;
+	int64_t coef = 0;
+	double dbl;
+	char *end;
+
+	if (!reserve(rec, 10))
+		return false;
+	for (size_t index = 0; index < digits; index++)
+		points += num[index] == '.';
+	if (Flags.fixed && num[digits] != 'E' && points <= 1 && digits - points <= MAX_COEF) {	// Exact coefficient
+		for (const char *chr = num; chr < num + digits; chr++) {
+			if (*chr == '.')
+				places = num + digits - chr - 1;
+			else
+				coef = coef * 10 + *chr - '0';
+		}
+		rec->data[rec->len] = REC_DECIMAL;
+		putu64(rec->data + rec->len + 1, coef);
+		rec->data[rec->len + 9] = places;
+		rec->len += 10;
+		*str = num + digits;
+		return true;
+	}
+	dbl = strtod(num, &end);
+	if (end == num)	// Lone decimal point
+		end++;
+	memcpy(&bits, &dbl, sizeof(bits));
+	rec->data[rec->len] = REC_DOUBLE;
+	putu64(rec->data + rec->len + 1, bits);
+	rec->len += 9;
+	*str = end;
+	return true;
+}
+
+bool recencode(FILE *in, FILE *out) {
+	struct Buffer rec = {NULL, 0, 0};
+	char *line = NULL;
+	const char *chr;
+	size_t size = 0;
+	ssize_t len;
+	bool ok = true;
+
+	while (ok && (len = getline(&line, &size, in)) > 0) {
+		if (line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (!len)	// Empty line ends input, as in batch mode
+			break;
+		rec.len = 0;
+		if (!(ok = reserve(&rec, HEADER_REQ)))
+			break;
+		rec.len = HEADER_REQ;
+		for (chr = line; ok && *chr; ) {
+			if (isspace(*chr))
+				chr++;
+			else if (isdigit(*chr) || *chr == '.')
+				ok = putnum(&rec, &chr);
+			else if ((ok = reserve(&rec, 1)))
+				rec.data[rec.len++] = *chr++;
+		}
+		putu32(rec.data, rec.len - HEADER_REQ);
+		if (ok && fwrite(rec.data, 1, rec.len, out) != rec.len) {
+			setstat(ERR_INTERNAL);
+			ok = false;
+		}
+	}
+	free(line);
+	free(rec.data);
+	return ok && fflush(out) == 0;
+}
+
+bool recdecode(FILE *in, FILE *out, unsigned sig) {
+	unsigned char body[RES_MAX];
+	char *result, *swap;
+	int stat, tag;
+	dec_t dec;
+	double dbl;
+	uint64_t bits;
+
+	while ((stat = getc(in)) != EOF) {
+		if (stat) {
+			fprintf(out, "Error: %s\n", strstat(stat));
+			continue;
+		}
+		if ((tag = getc(in)) == REC_DOUBLE && fread(body, 1, 8, in) == 8) {
+			bits = getu64(body);
+			memcpy(&dbl, &bits, sizeof(dbl));
+			result = dtos(dbl, MaxDec);	// Same formatting as parse()
+			if ((swap = result)) {
+				result = pprint(result);
+				xfree(swap);
+			}
+			if (result)
+				result = roundnum(result, sig);
+		} else if (tag == REC_DECIMAL && fread(body, 1, 17, in) == 17) {
+			dec = (dec_t) ((unsigned __int128) getu64(body) << 64 | getu64(body + 8));
+			if (decinit(body[16], DecRound))
+				result = dectos(dec, false);
+			else {
+				setstat(ERR_INVDEC);
+				result = NULL;
+			}
+		} else {	// Truncated or foreign record
+			setstat(ERR_INTERNAL);
+			return false;
+		}
+		if (result)
+			fprintf(out, "%s\n", result);
+		else
+			fprintf(out, "Error: %s\n", strstat(ErrStat));
+		xfree(result);
+		ErrStat = 0;
+	}
+	return fflush(out) == 0;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdbool.h>	// bool
+#include <stdio.h>		// FILE
+#include "global.h"		// attribute()
+
+/* Binary records, for pipelines that already hold parsed numbers
+ * Request:  uint32 length (big-endian), then length bytes of tokens
+ *           Operators and parentheses are their characters, as in text, with ++, -- and !! as two bytes
+ *           REC_DOUBLE is followed by an IEEE 754 double (8 bytes, big-endian)
+ *           REC_DECIMAL is followed by an int64 coefficient (big-endian) and uint8 decimal places
+ * Response: uint8 status (0 or enum ErrorStatus), then, on success, either
+ *           REC_DOUBLE and a double, or in fixed-point mode,
+ *           REC_DECIMAL, an int128 coefficient (16 bytes, big-endian) and uint8 decimal places
+ * Numbers are never converted to or from text, so results are not rounded to -d */
+
+#define REC_DOUBLE	0x01
+#define REC_DECIMAL	0x02
+#define REC_MAX		(1 << 20)	// Largest accepted request, in bytes
+#define REC_DEPTH	256			// Deepest accepted nesting of parentheses
+
+/* Evaluates request records from one file descriptor, writing response records to another, until end of input
+ * Responses are written whenever no complete request remains buffered
+ * Returns false on failure */
+extern bool recserve(int in, int out);
+
+/* Converts each line of text to a request record, until end of input or an empty line
+ * Characters that are not part of an expression are kept, so that their request fails with a syntax error
+ * Returns false on failure */
+extern bool recencode(FILE *in, FILE *out)
+attribute(__nonnull__(1, 2));
+
+/* Converts each response record to a line of text, rounded to given decimals
+ * Returns false on failure */
+extern bool recdecode(FILE *in, FILE *out, unsigned sig)
+attribute(__nonnull__(1, 2));
+
+#endif // #ifndef RECORD_H
\ No newline at end of file
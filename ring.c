@@ -0,0 +1,224 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include "global.h"
+#include "mem.h"
+#include "ring.h"
+#include "status.h"
+#include "stmt.h"
+
+#if LINUX
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SPIN_MIN	64			// Bounds of adaptive busy-poll, in iterations
+#define SPIN_MAX	(1 << 16)
+#define YIELDS		16			// Yields between busy-poll and sleeping
+#define SLEEP_NS	100000000	// Longest futex wait, so closing is noticed without a wake-up
+
+static unsigned Spins = 1024;	// Current busy-poll budget
+static volatile sig_atomic_t Stop = false;
+
+static void onsignal(int sig) {Stop = true;}
+
+/* Hints to processor that this is a spin-wait loop */
+static inline void relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ volatile("yield");
+#endif
+}
+
+static void futex_wait(_Atomic uint32_t *word, uint32_t old) {
+	struct timespec timeout = {0, SLEEP_NS};
+
+	syscall(SYS_futex, (uint32_t *) word, FUTEX_WAIT, old, &timeout, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t *word) {
+	syscall(SYS_futex, (uint32_t *) word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/* Waits for word to change from given value, busy-polling before sleeping
+ * Budget grows when polling succeeds and shrinks when sleeping was needed
+ * Returns false if region was closed or process interrupted */
+static bool waitfor(struct RingRegion *region, _Atomic uint32_t *word, uint32_t old, _Atomic uint32_t *sleeping) {
+	for (unsigned spin = 0; ; spin++) {
+		if (atomic_load_explicit(word, memory_order_acquire) != old) {
+			if (spin < Spins && Spins < SPIN_MAX)
+				Spins *= 2;
+			return true;
+		}
+		if (atomic_load_explicit(&region->closed, memory_order_relaxed) || Stop)
+			return false;
+		if (spin < Spins)
+			relax();
+		else if (spin < Spins + YIELDS)
+			sched_yield();
+		else {
+			if (Spins > SPIN_MIN)
+				Spins /= 2;
+			atomic_store(sleeping, true);
+			if (atomic_load(word) == old)	// Recheck after announcing sleep
+				futex_wait(word, old);
+			atomic_store(sleeping, false);
+			spin = 0;
+		}
+	}
+}
+
+/* Publishes new value of word, waking sleeper if present */
+static void signal_word(_Atomic uint32_t *word, uint32_t val, _Atomic uint32_t *sleeping) {
+	atomic_store(word, val);
+	if (atomic_load(sleeping))
+		futex_wake(word);
+}
+#endif // #if LINUX
+
+struct RingRegion *ring_attach(const char *name, bool create) {
+#if LINUX
+	struct RingRegion *region;
+	int fd;
+
+	if (sysconf(_SC_NPROCESSORS_ONLN) < 2)
+		Spins = 0;	// Polling only delays the other side on a single processor
+	if ((fd = shm_open(name, O_RDWR | (create ? O_CREAT : 0), 0600)) < 0) {
+		setstat(ERR_INTERNAL);
+		return NULL;
+	}
+	if (create && ftruncate(fd, sizeof(struct RingRegion))) {
+		close(fd);
+		setstat(ERR_INTERNAL);
+		return NULL;
+	}
+	region = mmap(NULL, sizeof(struct RingRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (region == MAP_FAILED) {
+		setstat(ERR_INTERNAL);
+		return NULL;
+	}
+	if (create) {	// New or stale region: indices left by an earlier server would replay old requests
+		memset(region, 0, sizeof(struct RingRegion));
+		region->magic = RING_MAGIC;
+	} else if (region->magic != RING_MAGIC) {
+		munmap(region, sizeof(struct RingRegion));
+		setstat(ERR_INTERNAL);
+		return NULL;
+	}
+	return region;
+#else
+	errno = ENOSYS;
+	setstat(ERR_INTERNAL);
+	return NULL;
+#endif // #if LINUX
+}
+
+void ring_detach(struct RingRegion *region) {
+#if LINUX
+	if (region)
+		munmap(region, sizeof(struct RingRegion));
+#endif // #if LINUX
+}
+
+struct RingSlot *ring_claim(struct RingRegion *region, struct Ring *ring, bool wait) {
+#if LINUX
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);	// Only producer writes head
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	while (head - tail == RING_SLOTS) {
+		if (!wait || !waitfor(region, &ring->tail, tail, &ring->tailwait))
+			return NULL;
+		tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	}
+	return &ring->slots[head % RING_SLOTS];
+#else
+	return NULL;
+#endif // #if LINUX
+}
+
+void ring_publish(struct Ring *ring) {
+#if LINUX
+	signal_word(&ring->head, atomic_load_explicit(&ring->head, memory_order_relaxed) + 1, &ring->headwait);
+#endif // #if LINUX
+}
+
+struct RingSlot *ring_next(struct RingRegion *region, struct Ring *ring, bool wait) {
+#if LINUX
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);	// Only consumer writes tail
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	while (head == tail) {
+		if (!wait || !waitfor(region, &ring->head, head, &ring->headwait))
+			return NULL;
+		head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	}
+	return &ring->slots[tail % RING_SLOTS];
+#else
+	return NULL;
+#endif // #if LINUX
+}
+
+void ring_release(struct Ring *ring) {
+#if LINUX
+	signal_word(&ring->tail, atomic_load_explicit(&ring->tail, memory_order_relaxed) + 1, &ring->tailwait);
+#endif // #if LINUX
+}
+
+bool ringserve(const char *name) {
+#if LINUX
+	struct sigaction act = {.sa_handler = onsignal};
+	struct RingRegion *region;
+	struct RingSlot *req, *res;
+	const char *payload;
+	char *result;
+	size_t len;
+	int stat;
+
+	if (!(region = ring_attach(name, true)))
+		return false;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+	while ((req = ring_next(region, &region->req, true))) {
+		if (!(res = ring_claim(region, &region->res, true)))
+			break;
+		result = NULL;
+		if (req->len >= RING_DATA || req->data[req->len])	// Expression must be null-terminated within slot
+			stat = ERR_INPUTSIZE;
+		else {
+			ErrStat = 0;
+			clrvars();	// Requests are independent
+			result = parse_line(req->data, req->sig > MaxDec ? MaxDec : req->sig);
+			stat = result ? 0 : ErrStat;
+		}
+		payload = result ? result : strstat(stat);
+		if ((len = strlen(payload)) >= RING_DATA) {
+			stat = ERR_INPUTSIZE;
+			payload = strstat(stat);
+			len = strlen(payload);
+		}
+		memcpy(res->data, payload, len + 1);
+		res->len = len;
+		res->stat = stat;
+		xfree(result);
+		ring_release(&region->req);
+		ring_publish(&region->res);
+	}
+	ring_detach(region);
+	shm_unlink(name);
+	return true;
+#else
+	errno = ENOSYS;
+	setstat(ERR_INTERNAL);
+	return false;
+#endif // #if LINUX
+}
\ No newline at end of file
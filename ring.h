@@ -0,0 +1,77 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>	// _Atomic
+#include <stdbool.h>	// bool
+#include <stdint.h>		// uint32_t
+#include "global.h"		// attribute()
+
+#define RING_SLOTS	256		// Slots per ring, power of 2
+#define RING_DATA	248		// Bytes of expression or result per slot, including null character
+#define RING_MAGIC	0x50524E47	// "PRNG"
+#define CACHE_LINE	64
+
+/* Fixed-size slot, written in place by its producer and read in place by its consumer
+ * Requests hold a line, as parse_line() takes it, and the number of decimals; variables do not outlive the request
+ * Responses hold a status (0 or enum ErrorStatus) and the result or error message */
+struct RingSlot {
+	uint32_t len;	// Bytes in data, excluding null character
+	uint8_t stat;
+	uint8_t sig;
+	char data[RING_DATA];
+};
+
+/* Single-producer/single-consumer queue of slots */
+struct Ring {
+	_Atomic uint32_t head;		// Slots published by producer
+	_Atomic uint32_t headwait;	// Consumer is sleeping on head?
+	char pad_head[CACHE_LINE - 2 * sizeof(uint32_t)];
+	_Atomic uint32_t tail;		// Slots released by consumer
+	_Atomic uint32_t tailwait;	// Producer is sleeping on tail?
+	char pad_tail[CACHE_LINE - 2 * sizeof(uint32_t)];
+	struct RingSlot slots[RING_SLOTS];
+};
+
+/* Shared-memory region: caller produces requests and consumes responses, evaluator does the opposite */
+struct RingRegion {
+	uint32_t magic;
+	_Atomic uint32_t closed;	// Set by caller to stop evaluator
+	char pad[CACHE_LINE - 2 * sizeof(uint32_t)];
+	struct Ring req, res;
+};
+
+/* Maps shared-memory region of given POSIX name (e.g. "/parse"), creating it if requested
+ * If create is true, region is reset to empty rings, discarding anything left in it
+ * Returns NULL on failure */
+extern struct RingRegion *ring_attach(const char *name, bool create)
+attribute(__warn_unused_result__, __nonnull__(1));
+
+/* Unmaps shared-memory region */
+extern void ring_detach(struct RingRegion *region);
+
+/* Returns next free slot of ring for producer to write in place
+ * If wait is true, blocks until one is free or region is closed
+ * Returns NULL if ring is full or region is closed */
+extern struct RingSlot *ring_claim(struct RingRegion *region, struct Ring *ring, bool wait)
+attribute(__nonnull__(1, 2));
+
+/* Makes last claimed slot visible to consumer */
+extern void ring_publish(struct Ring *ring)
+attribute(__nonnull__(1));
+
+/* Returns oldest published slot of ring for consumer to read in place
+ * If wait is true, blocks until one is published or region is closed
+ * Returns NULL if ring is empty or region is closed */
+extern struct RingSlot *ring_next(struct RingRegion *region, struct Ring *ring, bool wait)
+attribute(__nonnull__(1, 2));
+
+/* Returns oldest published slot to producer */
+extern void ring_release(struct Ring *ring)
+attribute(__nonnull__(1));
+
+/* Evaluates requests of shared-memory region until it is closed or the process is interrupted
+ * Returns false on failure */
+extern bool ringserve(const char *name)
+attribute(__nonnull__(1));
+
+#endif // #ifndef RING_H
\ No newline at end of file
@@ -0,0 +1,447 @@
+#define _GNU_SOURCE	// accept4()
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+#include "mem.h"
+#include "serve.h"
+#include "status.h"
+#include "stmt.h"
+#include "util.h"
+
+#if LINUX
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define HEADER_REQ	5	// Length, decimals
+#define HEADER_RES	5	// Status, length
+#define MAX_EVENTS	64
+#define IN_MAX		(HEADER_REQ + FRAME_MAX)	// Input held per connection, enough for any frame
+#define OUT_HIGH	(1 << 20)					// Pending output above which input is no longer read
+#define OUT_MAX		(16 << 20)					// Pending output above which connection is dropped
+
+struct Buffer {
+	char *data;
+	size_t len, cap, off;	// Bytes held, bytes allocated, bytes already consumed
+};
+
+struct Connection {
+	int fd;
+	uint32_t events;	// Registered epoll events
+	struct Buffer in, out;
+};
+
+static volatile sig_atomic_t Stop = false;
+
+static void onsignal(int sig) {Stop = true;}
+
+static void putu32(unsigned char *dest, uint32_t x) {
+	dest[0] = x >> 24, dest[1] = x >> 16, dest[2] = x >> 8, dest[3] = x;
+}
+
+static uint32_t getu32(const unsigned char *src) {
+	return (uint32_t) src[0] << 24 | (uint32_t) src[1] << 16 | (uint32_t) src[2] << 8 | src[3];
+}
+
+/* Ensures room for given number of bytes past end of buffer
+ * Returns false on failure */
+static bool reserve(struct Buffer *buf, size_t size) {
+	char *swap;
+	size_t cap = buf->cap ? buf->cap : 256;
+
+	if (buf->len + size <= buf->cap)
+		return true;
+	while (cap < buf->len + size)	cap *= 2;
+	if (!(swap = realloc(buf->data, cap)))
+		return false;
+	buf->data = swap;
+	buf->cap = cap;
+	return true;
+}
+
+/* Appends response frame to buffer
+ * Returns false on failure */
+static bool putres(struct Buffer *buf, int stat, const char *payload) {
+	size_t len = strlen(payload);
+
+	if (!reserve(buf, HEADER_RES + len))
+		return false;
+	buf->data[buf->len] = stat;
+	putu32((unsigned char *) buf->data + buf->len + 1, len);
+	memcpy(buf->data + buf->len + HEADER_RES, payload, len);
+	buf->len += HEADER_RES + len;
+	return true;
+}
+
+static void dropconn(int epfd, struct Connection *conn) {
+	epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	free(conn->in.data);
+	free(conn->out.data);
+	free(conn);
+}
+
+/* Evaluates every complete request held by connection, queueing responses in order
+ * Returns false if connection must be dropped */
+static bool answer(struct Connection *conn) {
+	struct Buffer *in = &conn->in;
+	unsigned char *frame;
+	char *result, save;
+	uint32_t len;
+	bool ok;
+
+	while (in->len - in->off >= HEADER_REQ) {
+		frame = (unsigned char *) in->data + in->off;
+		if ((len = getu32(frame)) > FRAME_MAX) {
+			putres(&conn->out, ERR_INPUTSIZE, strstat(ERR_INPUTSIZE));
+			return false;
+		}
+		if (in->len - in->off < HEADER_REQ + len)
+			break;	// Wait for rest of frame
+		save = frame[HEADER_REQ + len];	// Evaluate in place, buffer always has a spare byte
+		frame[HEADER_REQ + len] = '\0';
+		ErrStat = 0;
+		clrvars();	// Requests are independent, whichever connection or worker saw others before
+		result = parse_line((char *) frame + HEADER_REQ, frame[4] > MaxDec ? MaxDec : frame[4]);
+		frame[HEADER_REQ + len] = save;
+		ok = result ? putres(&conn->out, 0, result) : putres(&conn->out, ErrStat, strstat(ErrStat));
+		xfree(result);
+		if (!ok)
+			return false;
+		in->off += HEADER_REQ + len;
+	}
+	memmove(in->data, in->data + in->off, in->len - in->off);	// Keep partial frame
+	in->len -= in->off;
+	in->off = 0;
+	return true;
+}
+
+/* Writes as much pending output as the socket accepts
+ * Input is no longer read while more than OUT_HIGH bytes are pending, so a client that does not read cannot grow them
+ * Returns false if connection must be dropped */
+static bool flush(int epfd, struct Connection *conn) {
+	struct Buffer *out = &conn->out;
+	struct epoll_event ev;
+	ssize_t sent;
+
+	while (out->off < out->len) {
+		sent = send(conn->fd, out->data + out->off, out->len - out->off, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return false;
+		}
+		out->off += sent;
+	}
+	if (out->off) {	// Keep unsent bytes at start, so buffer does not creep
+		memmove(out->data, out->data + out->off, out->len - out->off);
+		out->len -= out->off;
+		out->off = 0;
+	}
+	if (out->len > OUT_MAX)	// Responses to the last input read alone outgrew limit
+		return false;
+	ev.events = (out->len <= OUT_HIGH ? EPOLLIN : 0) | (out->len ? EPOLLOUT : 0);
+	if (conn->events != ev.events) {
+		conn->events = ev.events;
+		ev.data.ptr = conn;
+		if (epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev))
+			return false;
+	}
+	return true;
+}
+
+/* Reads available input of connection, up to IN_MAX bytes held
+ * The rest stays in the socket until held frames are answered
+ * Returns false if connection must be dropped */
+static bool receive(struct Connection *conn) {
+	struct Buffer *in = &conn->in;
+	size_t room;
+	ssize_t got;
+
+	while (in->len < IN_MAX) {
+		if (!reserve(in, 4096 + 1 /* Spare byte for in-place null character */))
+			return false;
+		room = in->cap - in->len - 1;
+		got = recv(conn->fd, in->data + in->len, room < IN_MAX - in->len ? room : IN_MAX - in->len, 0);
+		if (got < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		if (got == 0)
+			return false;	// Peer closed
+		in->len += got;
+	}
+	return true;
+}
+
+/* Runs event loop on listening socket until interrupted
+ * Returns false on failure */
+static bool evloop(int listenfd) {
+	struct epoll_event ev, events[MAX_EVENTS];
+	struct Connection *conn;
+	int epfd, nready, fd;
+
+	if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		return false;
+	ev.events = EPOLLIN | EPOLLEXCLUSIVE;	// Wake one worker per connection attempt
+	ev.data.ptr = NULL;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, listenfd, &ev)) {
+		close(epfd);
+		return false;
+	}
+	while (!Stop) {
+		if ((nready = epoll_wait(epfd, events, MAX_EVENTS, -1)) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (int index = 0; index < nready; index++) {
+			if (!(conn = events[index].data.ptr)) {	// New connections
+				while ((fd = accept4(listenfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+					if (!(conn = calloc(1, sizeof(struct Connection)))) {
+						close(fd);
+						continue;
+					}
+					conn->fd = fd;
+					ev.events = conn->events = EPOLLIN;
+					ev.data.ptr = conn;
+					if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)) {
+						close(fd);
+						free(conn);
+					}
+				}
+				continue;
+			}
+			if (events[index].events & EPOLLIN && (!receive(conn) || !answer(conn))) {
+				flush(epfd, conn);	// Best effort for last responses
+				dropconn(epfd, conn);
+				continue;
+			}
+			if (events[index].events & (EPOLLERR | EPOLLHUP) && !(events[index].events & EPOLLIN) ||
+				!flush(epfd, conn))
+				dropconn(epfd, conn);
+		}
+	}
+	close(epfd);
+	return Stop;
+}
+
+/* Forks worker running event loop on listening socket
+ * Returns its process ID, or -1 on failure */
+static pid_t spawn(int listenfd) {
+	pid_t pid;
+
+	if ((pid = fork()) == 0)
+		exit(evloop(listenfd) ? EXIT_SUCCESS : EXIT_FAILURE);
+	return pid;
+}
+#endif // #if LINUX
+
+bool serve(const char *path) {
+#if LINUX
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	struct sigaction act = {.sa_handler = onsignal};
+	pid_t *workers, pid;
+	long nworker = sysconf(_SC_NPROCESSORS_ONLN), alive = 0, index;
+	int listenfd, status;
+	bool stopping = false;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		setstat(ERR_INVARG);
+		return false;
+	}
+	strcpy(addr.sun_path, path);
+	sigaction(SIGINT, &act, NULL);	// No SA_RESTART, so epoll_wait() returns
+	sigaction(SIGTERM, &act, NULL);
+	unlink(path);
+	if ((listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0 ||
+		bind(listenfd, (struct sockaddr *) &addr, sizeof(addr)) ||
+		listen(listenfd, SOMAXCONN)) {
+		setstat(ERR_INTERNAL);
+		return false;
+	}
+	if (nworker < 1)
+		nworker = 1;
+	if (!(workers = calloc(nworker, sizeof(pid_t)))) {
+		setstat(ERR_INTERNAL);
+		close(listenfd);
+		unlink(path);
+		return false;
+	}
+	for (index = 0; index < nworker; index++)
+		alive += (workers[index] = spawn(listenfd)) > 0;
+	while (alive) {	// This process only supervises workers
+		if (Stop && !stopping) {
+			for (index = 0; index < nworker; index++)
+				if (workers[index] > 0)
+					kill(workers[index], SIGTERM);
+			stopping = true;
+		}
+		if ((pid = wait(&status)) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (index = 0; index < nworker && workers[index] != pid; index++);
+		if (index == nworker)
+			continue;
+		if (!Stop && WIFSIGNALED(status) && (workers[index] = spawn(listenfd)) > 0)	// Crashed, most likely on one request
+			continue;
+		workers[index] = 0;
+		alive--;
+	}
+	free(workers);
+	close(listenfd);
+	unlink(path);
+	if (!Stop)	// Every worker failed
+		setstat(ERR_INTERNAL);
+	return Stop;
+#else
+	errno = ENOSYS;
+	setstat(ERR_INTERNAL);
+	return false;
+#endif // #if LINUX
+}
+
+#if LINUX
+/* Writes entire buffer to socket
+ * Returns false on failure */
+static bool sendall(int fd, const void *data, size_t len) {
+	ssize_t sent;
+
+	for (size_t off = 0; off < len; off += sent)
+		if ((sent = send(fd, (const char *) data + off, len - off, MSG_NOSIGNAL)) <= 0)
+			return false;
+	return true;
+}
+
+/* Reads exactly given number of bytes from socket
+ * Returns false on failure */
+static bool recvall(int fd, void *data, size_t len) {
+	ssize_t got;
+
+	for (size_t off = 0; off < len; off += got)
+		if ((got = recv(fd, (char *) data + off, len - off, 0)) <= 0)
+			return false;
+	return true;
+}
+
+/* Sends request frame
+ * Returns false on failure */
+static bool sendreq(int fd, const char *expr, unsigned sig) {
+	unsigned char header[HEADER_REQ];
+	size_t len = strlen(expr);
+
+	if (len > FRAME_MAX) {
+		setstat(ERR_INPUTSIZE);
+		return false;
+	}
+	putu32(header, len);
+	header[4] = sig;
+	if (!sendall(fd, header, HEADER_REQ) || !sendall(fd, expr, len)) {
+		setstat(ERR_INTERNAL);
+		return false;
+	}
+	return true;
+}
+
+/* Receives response frame and prints it
+ * Returns status of response, or -1 on failure */
+static int recvres(int fd) {
+	unsigned char header[HEADER_RES];
+	char *payload;
+	uint32_t len;
+	int stat;
+
+	if (!recvall(fd, header, HEADER_RES) || (len = getu32(header + 1)) > FRAME_MAX) {
+		setstat(ERR_INTERNAL);
+		return -1;
+	}
+	if (!(payload = malloc(len + 1))) {
+		setstat(ERR_INTERNAL);
+		return -1;
+	}
+	if (!recvall(fd, payload, len)) {
+		free(payload);
+		setstat(ERR_INTERNAL);
+		return -1;
+	}
+	payload[len] = '\0';
+	if ((stat = header[0]))
+		printf("Error: %s\n", payload);
+	else
+		puts(payload);
+	free(payload);
+	return stat;
+}
+#endif // #if LINUX
+
+bool client(const char *path, const char *expr, unsigned sig) {
+#if LINUX
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	char *line = NULL;
+	size_t linecap = 0, inflight = 0;
+	ssize_t len;
+	int fd, stat;
+	bool ok = true, eof = false;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		setstat(ERR_INVARG);
+		return false;
+	}
+	strcpy(addr.sun_path, path);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0 ||
+		connect(fd, (struct sockaddr *) &addr, sizeof(addr))) {
+		setstat(ERR_INTERNAL);
+		if (fd >= 0)
+			close(fd);
+		return false;
+	}
+	if (expr) {
+		if (!sendreq(fd, expr, sig) || (stat = recvres(fd)) < 0) {
+			close(fd);
+			return false;
+		}
+		close(fd);
+		return stat == 0;
+	}
+	while (!eof || inflight) {
+		while (!eof && inflight < PIPE_DEPTH) {	// Fill pipeline
+			if ((len = getline(&line, &linecap, stdin)) < 0) {
+				eof = true;
+				break;
+			}
+			if (len && line[len - 1] == '\n')
+				line[len - 1] = '\0';
+			if (!sendreq(fd, line, sig)) {
+				free(line);
+				close(fd);
+				return false;
+			}
+			inflight++;
+		}
+		if (inflight) {
+			if ((stat = recvres(fd)) < 0) {
+				free(line);
+				close(fd);
+				return false;
+			}
+			ok = ok && !stat;
+			inflight--;
+		}
+	}
+	free(line);
+	close(fd);
+	return ok;
+#else
+	errno = ENOSYS;
+	setstat(ERR_INTERNAL);
+	return false;
+#endif // #if LINUX
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdbool.h>	// bool
+#include "global.h"		// attribute()
+
+/* Protocol
+ * Request:  uint32 length (big-endian), uint8 decimals, line (length bytes, not null-terminated), as parse_line() takes it
+ * Response: uint8 status (0 or enum ErrorStatus), uint32 length (big-endian), result or error message (length bytes)
+ * Requests may be pipelined; responses are returned in request order per connection
+ * Variables assigned by one request are not seen by any other */
+
+#define FRAME_MAX	(1 << 20)	// Largest accepted expression, in bytes
+#define PIPE_DEPTH	64			// Requests kept in flight by client
+
+/* Evaluates requests from clients of UNIX domain socket until interrupted
+ * Forks one event loop per online processor, all sharing the listening socket, and restarts any that crash
+ * Clients that send faster than they read stop being read from, and are dropped if their responses still grow too large
+ * Returns false on failure */
+extern bool serve(const char *path)
+attribute(__nonnull__(1));
+
+/* Sends expression to server and prints result
+ * If expression is NULL, sends every line of stdin instead, keeping up to PIPE_DEPTH requests in flight
+ * Returns false on failure or if any expression failed to evaluate */
+extern bool client(const char *path, const char *expr, unsigned sig)
+attribute(__nonnull__(1));
+
+#endif // #ifndef SERVE_H
\ No newline at end of file
@@ -0,0 +1,367 @@
+#define _GNU_SOURCE	// asprintf()
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+#include "mem.h"
+#include "parse.h"
+#include "shard.h"
+#include "status.h"
+#include "stmt.h"
+
+#if LINUX
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define READ_SIZE	65536
+#define COPY_SIZE	65536
+#define POLL_NS		10000000	// Between checks of workers, 10 ms
+#define NO_CHUNK	UINT32_MAX
+
+enum ChunkState {CHUNK_PENDING, CHUNK_RUNNING, CHUNK_DONE};
+
+/* Lines of input, and where their answers were written
+ * Output is only appended to, so answers survive the worker that wrote them */
+struct Chunk {
+	size_t begin, end;	// Bytes of input
+	size_t lines;		// Lines answered
+	unsigned crashes;	// Workers lost on next line, counted by supervisor
+	unsigned file;		// Output file of worker that took chunk
+	off_t off, len;		// Bytes of output in file
+	_Atomic int state;
+};
+
+/* Worker slot, kept by supervisor across restarts */
+struct Worker {
+	_Atomic uint64_t range;		// Chunks left to worker, first in low 32 bits and end in high 32 bits
+	_Atomic uint32_t inflight;	// Chunk being answered, or NO_CHUNK
+	_Atomic uint64_t beat;		// Lines answered, to tell stalled workers
+	off_t end;		// Bytes written to output file
+	pid_t pid;		// 0 once finished, kept by supervisor like the rest
+	uint64_t seen;	// Beat at last check
+	time_t since;	// Time beat last changed
+};
+
+/* Mapped once, shared by every worker */
+struct Shard {
+	const char *input;
+	unsigned sig;
+	uint32_t nchunk;
+	unsigned nworker;
+	int *files;
+	struct Worker *workers;
+	struct Chunk *chunks;
+};
+
+#define pack(first, end)	((uint64_t) (end) << 32 | (first))
+
+/* Writes entire buffer to file at given offset
+ * Returns false on failure */
+static bool pwriteall(int fd, const char *data, size_t len, off_t off) {
+	ssize_t done;
+
+	while (len) {
+		if ((done = pwrite(fd, data, len, off)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		data += done, len -= done, off += done;
+	}
+	return true;
+}
+
+/* Reads all of file descriptor into malloc'd buffer
+ * Returns NULL on failure */
+static char *readall(int fd, size_t *len) {
+	char *data = NULL, *swap;
+	size_t cap = 0;
+	ssize_t got;
+
+	*len = 0;
+	while (true) {
+		if (cap - *len < READ_SIZE) {
+			if (!(swap = realloc(data, cap = cap ? cap * 2 : READ_SIZE))) {
+				free(data);
+				return NULL;
+			}
+			data = swap;
+		}
+		if ((got = read(fd, data + *len, cap - *len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			free(data);
+			return NULL;
+		}
+		if (!got)
+			return data;
+		*len += got;
+	}
+}
+
+/* Takes next chunk of own range, or else steals last chunk of another worker's
+ * Returns NO_CHUNK once none are left */
+static uint32_t takechunk(struct Shard *shard, unsigned self) {
+	struct Worker *victim;
+	uint64_t range;
+	uint32_t first, end;
+
+	for (unsigned index = 0; index < shard->nworker; index++) {
+		victim = &shard->workers[(self + index) % shard->nworker];
+		range = atomic_load(&victim->range);
+		do {
+			first = range, end = range >> 32;
+			if (first == end)
+				break;
+		} while (index ? !atomic_compare_exchange_weak(&victim->range, &range, pack(first, end - 1)) :
+						 !atomic_compare_exchange_weak(&victim->range, &range, pack(first + 1, end)));
+		if (first != end)
+			return index ? end - 1 : first;
+	}
+	return NO_CHUNK;
+}
+
+/* Evaluates line, writing result or error message and newline to buffer
+ * Variables of earlier lines are cleared first, since which lines a worker saw before depends on scheduling
+ * Returns length of buffer, or 0 on failure */
+static size_t answer(const char *line, unsigned sig, bool poison, char **buf) {
+	char *result = NULL;
+	FILE *stream;
+	size_t len;
+
+	clrstat();
+	clrvars();
+	if (poison) {	// Crashed too many workers
+		setstat(ERR_INTERNAL);
+	} else if (*line)
+		result = parse_line(line, sig);
+	if (result || !ErrStat) {
+		len = asprintf(buf, "%s\n", result ? result : "");
+		xfree(result);
+		return len == (size_t) -1 ? 0 : len;
+	}
+	if (!(stream = open_memstream(buf, &len)))	// Same message as without --jobs
+		return 0;
+	fstatus(stream);
+	if (fclose(stream)) {
+		free(*buf);
+		return 0;
+	}
+	return len;
+}
+
+/* Answers every line of chunk not yet answered
+ * Returns false on failure */
+static bool runchunk(struct Shard *shard, unsigned self, struct Chunk *chunk) {
+	struct Worker *worker = &shard->workers[self];
+	const char *pos = shard->input + chunk->begin, *end = shard->input + chunk->end, *newline;
+	char *line, *buf;
+	size_t len;
+	bool ok;
+
+	for (size_t skip = 0; skip < chunk->lines; skip++)	// Resuming after crash
+		pos = (const char *) memchr(pos, '\n', end - pos) + 1;
+	for (; pos < end; pos = newline + (newline < end)) {
+		if (!(newline = memchr(pos, '\n', end - pos)))	// Last line of input may have no newline
+			newline = end;
+		if (!(line = strndup(pos, newline - pos)))
+			return false;
+		len = answer(line, shard->sig, chunk->crashes >= SHARD_RETRY, &buf);
+		free(line);
+		if (!len)
+			return false;
+		ok = pwriteall(shard->files[self], buf, len, chunk->off + chunk->len);
+		free(buf);
+		if (!ok)
+			return false;
+		chunk->len += len;
+		worker->end = chunk->off + chunk->len;
+		chunk->lines++;
+		chunk->crashes = 0;
+		atomic_fetch_add(&worker->beat, 1);
+	}
+	return true;
+}
+
+/* Answers chunks until none are left, beginning with any held by crashed predecessor */
+static bool work(struct Shard *shard, unsigned self) {
+	struct Worker *worker = &shard->workers[self];
+	struct Chunk *chunk;
+	uint32_t index;
+
+	while ((index = atomic_load(&worker->inflight)) != NO_CHUNK || (index = takechunk(shard, self)) != NO_CHUNK) {
+		chunk = &shard->chunks[index];
+		if (atomic_load(&chunk->state) == CHUNK_PENDING) {
+			chunk->file = self;
+			chunk->off = worker->end;
+			atomic_store(&chunk->state, CHUNK_RUNNING);
+		}
+		atomic_store(&worker->inflight, index);
+		if (!runchunk(shard, self, chunk))
+			return false;
+		atomic_store(&chunk->state, CHUNK_DONE);
+		atomic_store(&worker->inflight, NO_CHUNK);
+	}
+	return true;
+}
+
+/* Starts worker in given slot
+ * Returns false on failure */
+static bool spawn(struct Shard *shard, unsigned self) {
+	struct Worker *worker = &shard->workers[self];
+	pid_t pid;
+
+	if ((pid = fork()) < 0)
+		return false;
+	if (!pid)	// Slot is shared, so only supervisor writes pid
+		_exit(work(shard, self) ? EXIT_SUCCESS : EXIT_FAILURE);
+	worker->pid = pid;
+	worker->seen = atomic_load(&worker->beat);
+	worker->since = time(NULL);
+	return true;
+}
+
+/* Writes output of each finished chunk that follows those already written
+ * Returns false on failure */
+static bool merge(struct Shard *shard, uint32_t *next, int out) {
+	static char buf[COPY_SIZE];
+	struct Chunk *chunk;
+	ssize_t got;
+
+	for (; *next < shard->nchunk && atomic_load(&(chunk = &shard->chunks[*next])->state) == CHUNK_DONE; ++*next) {
+		for (off_t off = 0; off < chunk->len; off += got) {
+			if ((got = pread(shard->files[chunk->file], buf, chunk->len - off < COPY_SIZE ? chunk->len - off : COPY_SIZE, chunk->off + off)) <= 0 ||
+				write(out, buf, got) != got)
+				return false;
+		}
+	}
+	return true;
+}
+
+/* Restarts workers that crashed or stalled, and collects those that finished
+ * Returns number of workers still running, or -1 on failure */
+static int supervise(struct Shard *shard) {
+	struct Worker *worker;
+	uint32_t inflight;
+	uint64_t beat;
+	pid_t pid;
+	int status, running = 0;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		for (worker = shard->workers; worker < shard->workers + shard->nworker && worker->pid != pid; worker++);
+		if (worker == shard->workers + shard->nworker)
+			continue;
+		worker->pid = 0;
+		if (WIFEXITED(status)) {	// Finished, or failed to write output, which a restart would not fix
+			if (WEXITSTATUS(status) != EXIT_SUCCESS)
+				return -1;
+			continue;
+		}
+		if ((inflight = atomic_load(&worker->inflight)) != NO_CHUNK)
+			shard->chunks[inflight].crashes++;	// Next line is suspect
+		if (!spawn(shard, worker - shard->workers))
+			return -1;
+	}
+	for (worker = shard->workers; worker < shard->workers + shard->nworker; worker++) {
+		if (!worker->pid)
+			continue;
+		running++;
+		if ((beat = atomic_load(&worker->beat)) != worker->seen || atomic_load(&worker->inflight) == NO_CHUNK) {
+			worker->seen = beat;
+			worker->since = time(NULL);
+		} else if (time(NULL) - worker->since >= SHARD_STALL) {
+			kill(worker->pid, SIGKILL);	// Collected as crashed
+			worker->since = time(NULL);
+		}
+	}
+	return running;
+}
+#endif // #if LINUX
+
+bool shardserve(unsigned nworker, unsigned sig, int in, int out) {
+#if LINUX
+	struct timespec poll = {0, POLL_NS};
+	struct Shard shard = {.sig = sig, .nworker = nworker};
+	FILE *file;
+	char *input, *pos, *newline;
+	size_t len, lines, size;
+	uint32_t next = 0;
+	int running;
+	bool ok = false;
+
+	if (!(input = readall(in, &len))) {
+		setstat(ERR_INTERNAL);
+		return false;
+	}
+	shard.input = input;
+	for (pos = input, lines = 0; pos < input + len; pos = newline + 1, lines++)
+		if (!(newline = memchr(pos, '\n', input + len - pos)))
+			newline = input + len;
+	if ((lines + SHARD_LINES - 1) / SHARD_LINES >= NO_CHUNK) {
+		setstat(ERR_INPUTSIZE);
+		free(input);
+		return false;
+	}
+	shard.nchunk = (lines + SHARD_LINES - 1) / SHARD_LINES;
+	size = nworker * (sizeof(struct Worker) + sizeof(int)) + shard.nchunk * sizeof(struct Chunk);
+	if ((shard.workers = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+		setstat(ERR_INTERNAL);
+		free(input);
+		return false;
+	}
+	shard.chunks = (struct Chunk *) (shard.workers + nworker);
+	shard.files = (int *) (shard.chunks + shard.nchunk);
+	pos = input;
+	for (uint32_t index = 0; index < shard.nchunk; index++) {	// Split at every SHARD_LINES newlines
+		shard.chunks[index].begin = pos - input;
+		for (lines = 0; lines < SHARD_LINES && pos < input + len; lines++)
+			pos = (newline = memchr(pos, '\n', input + len - pos)) ? newline + 1 : input + len;
+		shard.chunks[index].end = pos - input;
+	}
+	for (unsigned index = 0; index < nworker; index++) {
+		shard.workers[index].range = pack((uint64_t) shard.nchunk * index / nworker, (uint64_t) shard.nchunk * (index + 1) / nworker);
+		shard.workers[index].inflight = NO_CHUNK;
+		if (!(file = tmpfile()))	// Unlinked already, kept open by descriptor
+			goto fail;
+		shard.files[index] = dup(fileno(file));
+		fclose(file);
+		if (shard.files[index] < 0)
+			goto fail;
+	}
+	for (unsigned index = 0; index < nworker; index++)
+		if (!spawn(&shard, index))
+			goto fail;
+	while ((running = supervise(&shard)) > 0) {
+		if (!merge(&shard, &next, out))
+			goto fail;
+		nanosleep(&poll, NULL);
+	}
+	ok = running == 0 && merge(&shard, &next, out) && next == shard.nchunk;
+fail:
+	if (!ok) {
+		setstat(ERR_INTERNAL);
+		for (unsigned index = 0; index < nworker; index++)
+			if (shard.workers[index].pid > 0)
+				kill(shard.workers[index].pid, SIGKILL);
+		while (wait(NULL) > 0);
+	}
+	for (unsigned index = 0; index < nworker; index++)
+		if (shard.files[index] > 0)
+			close(shard.files[index]);
+	munmap(shard.workers, size);
+	free(input);
+	return ok;
+#else
+	errno = ENOSYS;
+	setstat(ERR_INTERNAL);
+	return false;
+#endif // #if LINUX
+}
\ No newline at end of file
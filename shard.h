@@ -0,0 +1,25 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stdbool.h>	// bool
+#include "global.h"		// attribute()
+
+/* Sharded batch evaluation
+ * Input is split into chunks of SHARD_LINES lines, dealt out evenly to worker processes
+ * A worker with no chunks left takes the last chunk of another, through descriptors in shared memory
+ * Each line is answered by one line of output, its result or error message, in input order
+ * Lines are evaluated independently: variables assigned on one line are not seen by any other, whichever worker has them
+ * A worker that crashes, or answers no line for SHARD_STALL seconds, is restarted on the chunk it held,
+ * from the line it was on, and a line that brings down SHARD_RETRY workers is answered with an internal error */
+
+#define SHARD_LINES	256		// Lines per chunk
+#define SHARD_RETRY	2		// Crashes on one line before it is given up
+#define SHARD_STALL	30		// Seconds without progress before worker is restarted
+#define SHARD_MAXJOB	1024	// Most worker processes
+
+/* Evaluates each line of one file descriptor across given number of processes, writing results to another
+ * Results are rounded to given decimals, and written as soon as every chunk before theirs is done
+ * Returns false on failure */
+extern bool shardserve(unsigned nworker, unsigned sig, int in, int out);
+
+#endif // #ifndef SHARD_H
\ No newline at end of file
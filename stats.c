@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "cache.h"
+#include "global.h"
+#include "mem.h"
+#include "stats.h"
+
+bool StatsOff = false;
+
+#ifdef STATS
+#define SUB_BITS	4								// Histogram precision, 1/16 of a power of 2
+#define SUB_COUNT	(1 << SUB_BITS)
+#define NBUCKET		((64 - SUB_BITS + 1) * SUB_COUNT)	// Enough for any 64-bit value, up to bucket of 2^63
+
+struct StageStats {
+	uint64_t calls, clocks, bytes;
+	uint64_t hist[NBUCKET];	// Log-linear latency histogram
+};
+
+static const char *StageNames[NSTAGE] = {
+	"chk_syntax", "chk_parenth", "parenthesis loop",
+	"oper ++", "oper --", "oper !!", "oper !", "oper ^", "oper /", "oper *", "oper %", "oper -", "oper +",
+	"dtos", "pprint", "roundnum"
+};
+static struct StageStats Stages[NSTAGE];
+
+uint64_t StatBytes = 0;
+
+/* Returns histogram bucket of value */
+static size_t bucket(uint64_t x) {
+	unsigned exp;
+
+	if (x < 2 * SUB_COUNT)
+		return x;
+	exp = 63 - __builtin_clzll(x);
+	return (exp - SUB_BITS) * SUB_COUNT + (x >> (exp - SUB_BITS));
+}
+
+/* Returns lowest value of histogram bucket */
+static uint64_t bucketlow(size_t index) {
+	unsigned exp;
+
+	if (index < 2 * SUB_COUNT)
+		return index;
+	exp = index / SUB_COUNT + SUB_BITS - 1;
+	return (uint64_t) (index % SUB_COUNT + SUB_COUNT) << (exp - SUB_BITS);
+}
+
+/* Returns value below which given fraction of calls fall */
+static uint64_t percentile(const struct StageStats *stage, double frac) {
+	uint64_t seen = 0, want = frac * stage->calls;
+
+	for (size_t index = 0; index < NBUCKET; index++)
+		if ((seen += stage->hist[index]) > want)
+			return bucketlow(index);
+	return 0;
+}
+
+uint64_t stat_nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void stat_record(enum Stage stage, uint64_t clock, uint64_t bytes) {
+	uint64_t elapsed = stat_clock() - clock;
+
+	if (StatsOff)
+		return;
+	Stages[stage].calls++;
+	Stages[stage].clocks += elapsed;
+	Stages[stage].bytes += StatBytes - bytes;
+	Stages[stage].hist[bucket(elapsed)]++;
+}
+#endif // #ifdef STATS
+
+void pstats(FILE *stream) {
+#ifdef STATS
+	const struct StageStats *stage;
+
+	fprintf(stream, "%-17s %10s %14s %10s %10s %10s %10s %12s\n",
+			"stage", "calls", "cycles", "cyc/call", "p50", "p99", "p99.9", "bytes");
+	for (size_t index = 0; index < NSTAGE; index++) {
+		if (!(stage = &Stages[index])->calls)
+			continue;
+		fprintf(stream, "%-17s %10llu %14llu %10llu %10llu %10llu %10llu %12llu\n", StageNames[index],
+				(unsigned long long) stage->calls, (unsigned long long) stage->clocks,
+				(unsigned long long) (stage->clocks / stage->calls),
+				(unsigned long long) percentile(stage, 0.5), (unsigned long long) percentile(stage, 0.99),
+				(unsigned long long) percentile(stage, 0.999), (unsigned long long) stage->bytes);
+	}
+	memset(Stages, 0, sizeof(Stages));
+#endif // #ifdef STATS
+	fprintf(stream, "cache: " SIZE_FMT " hits, " SIZE_FMT " misses\n", CacheHits, CacheMisses);
+	fprintf(stream, "memory: " SIZE_FMT " bytes peak", MemPeak);
+	if (MemBudget)
+		fprintf(stream, " of " SIZE_FMT " budget", MemBudget);
+	fputc('\n', stream);
+}
\ No newline at end of file
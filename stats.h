@@ -0,0 +1,60 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>	// uint64_t
+#include <stdio.h>	// FILE
+#include "global.h"
+
+/* Instrumentation is compiled in only when STATS is defined (e.g. -DSTATS), requires GCC or Clang
+ * Otherwise every macro below expands to nothing, or to the bare call */
+
+enum Stage {STG_SYNTAX, STG_PARENTH, STG_GROUPS,
+			STG_INCR, STG_DECR, STG_ROOT, STG_SQRT, STG_EXP, STG_DIV, STG_MUL, STG_MOD, STG_SUB, STG_ADD,	// parse_oper() passes
+			STG_DTOS, STG_PPRINT, STG_ROUND, NSTAGE};
+
+#ifdef STATS
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define stat_clock()	__rdtsc()	// Cycles
+#else
+#define stat_clock()	stat_nsec()	// Nanoseconds where no cycle counter is available
+#endif
+
+extern uint64_t StatBytes;	// Bytes allocated by evaluator so far
+
+/* Evaluates call, recording its duration and allocations under stage */
+#define staged(stage, call)	({									\
+		uint64_t stg_clock = stat_clock(), stg_bytes = StatBytes;	\
+		__typeof__(call) stg_result = (call);						\
+		stat_record(stage, stg_clock, stg_bytes);					\
+		stg_result;													\
+	})
+
+/* Marks beginning of a block recorded under a stage */
+#define stage_begin(var)	uint64_t var##_clock = stat_clock(), var##_bytes = StatBytes
+
+/* Records block begun with stage_begin() */
+#define stage_end(stage, var)	stat_record(stage, var##_clock, var##_bytes)
+
+/* Counts bytes allocated by evaluator */
+#define stat_alloc(size)	(StatBytes += (size))
+
+/* Returns monotonic time in nanoseconds */
+extern uint64_t stat_nsec(void);
+
+/* Adds call to stage, given clock and allocation count at its beginning */
+extern void stat_record(enum Stage stage, uint64_t clock, uint64_t bytes);
+#else
+#define staged(stage, call)		(call)
+#define stage_begin(var)
+#define stage_end(stage, var)
+#define stat_alloc(size)
+#endif // #ifdef STATS
+
+extern bool StatsOff;	// Stages are not recorded, so that previews leave statistics as they were
+
+/* Prints calls, cycles, latency percentiles and allocations of each stage, if compiled in, then clears them
+ * Also prints cache hit counts and peak memory of last evaluation */
+extern void pstats(FILE *stream);
+
+#endif // #ifndef STATS_H
\ No newline at end of file
@@ -7,61 +7,133 @@
 #include "util.h"
 
 int ErrStat = 0, ErrLn;
-char *ErrFile, *ErrStr = NULL;
-size_t ErrPos = 0;
+char *ErrFile;
+const char *ErrStr = NULL;
+size_t ErrPos = 0, ErrLen = 0;
 
-void clrstat(void) {if (ErrStr)	free(ErrStr);}
+/* Prints string as JSON string, escaping as needed */
+static void pjson(FILE *stream, const char *str, size_t len) {
+	char chr;
+
+	putc('"', stream);
+	for (size_t index = 0; index < len && (chr = str[index]); index++) {
+		if (chr == '"' || chr == '\\') {
+			putc('\\', stream);
+			putc(chr, stream);
+		} else if ((unsigned char) chr < ' ')
+			fprintf(stream, "\\u%04x", chr);
+		else
+			putc(chr, stream);
+	}
+	putc('"', stream);
+}
+
+/* Prints error record as JSON object, computing the span only now */
+static void pstatus_json(FILE *stream) {
+	fprintf(stream, "{\"status\":%d,\"error\":", ErrStat);
+	pjson(stream, strstat(ErrStat), SIZE_MAX);
+	switch(ErrStat) {
+	case ERR_INTERNAL:
+		fprintf(stream, ",\"file\":");
+		pjson(stream, ErrFile, SIZE_MAX);
+		fprintf(stream, ",\"line\":%d", ErrLn);
+		if (errno > 0) {
+			fprintf(stream, ",\"errno\":");
+			pjson(stream, strerror(errno), SIZE_MAX);
+		}
+		break;
+	case ERR_INVARG:
+		fprintf(stream, ",\"arg\":" SIZE_FMT, ErrPos);
+		break;
+	case ERR_INVFLAG:
+	case ERR_SYNTAX:
+		fprintf(stream, ",\"pos\":" SIZE_FMT ",\"len\":" SIZE_FMT ",\"span\":", ErrPos, ErrLen);
+		pjson(stream, ErrStr + ErrPos, ErrLen);
+		fprintf(stream, ",\"input\":");
+		pjson(stream, ErrStr, SIZE_MAX);
+		break;
+	}
+	fputs("}\n", stream);
+}
+
+void clrstat(void) {
+	ErrStat = 0;
+	ErrStr = NULL;
+	ErrPos = ErrLen = 0;
+}
+
+const char *strstat(int stat) {
+	switch(stat) {
+	case ERR_INTERNAL:	return "Internal error";
+	case ERR_INVFLAG:	return "Unknown flag";
+	case ERR_INVARG:	return "Invalid argument";
+	case ERR_INVDEC:	return "Invalid # of decimals";
+	case ERR_SYNTAX:	return "Invalid syntax";
+	case ERR_OVERFLOW:	return "Number too large";
+	case ERR_MISSOPER:	return "Missing operand";
+	case ERR_DIVZERO:	return "Divide by zero";
+	case ERR_MODULO:	return "Non-integer modulus";
+	case ERR_IMAGINARY:	return "Imaginary result";
+	case ERR_INPUTSIZE:	return "Input size too large";
+	case ERR_MEMLIMIT:	return "Memory budget exceeded";
+	case ERR_SHAPE:		return "Mismatched dimensions";
+	case ERR_CANCELLED:	return "Evaluation cancelled";
+	}
+	return "Success";
+}
 
 void pstatus(void) {
-	char *errmsg = "Success";
+	fstatus(stdout);
+}
 
+void fstatus(FILE *stream) {
 	if ((ErrStat == ERR_SYNTAX || ErrStat == ERR_INVFLAG) && !ErrStr) {	// String not specified
 		setstat(ERR_INTERNAL);
-		pstatus();
+		fstatus(stream);
 		return;
 	}
-	if (CmdLn)
-		printf("parse: ");
-	switch(ErrStat) {
-	case ERR_INTERNAL:	errmsg = "Internal error";			break;
-	case ERR_INVFLAG:	errmsg = "Unknown flag";			break;
-	case ERR_INVARG:	errmsg = "Invalid argument";		break;
-	case ERR_INVDEC:	errmsg = "Invalid # of decimals";	break;
-	case ERR_SYNTAX:	errmsg = "Invalid syntax";			break;
-	case ERR_OVERFLOW:	errmsg = "Number too large";		break;
-	case ERR_MISSOPER:	errmsg = "Missing operand";			break;
-	case ERR_DIVZERO:	errmsg = "Divide by zero";			break;
-	case ERR_MODULO:	errmsg = "Non-integer modulus";		break;
-	case ERR_IMAGINARY:	errmsg = "Imaginary result";		break;
-	case ERR_INPUTSIZE: errmsg = "Input size too large";	break;
+	if (Flags.json) {
+		pstatus_json(stream);
+		return;
 	}
-	printf("Error: %s", errmsg);
+	if (CmdLn)
+		fputs("parse: ", stream);
+	fputs("Error: ", stream);
+	fputs(strstat(ErrStat), stream);
 	switch(ErrStat) {
 	case ERR_INTERNAL:
-		printf(": %s: %d", ErrFile, ErrLn);
+		fprintf(stream, ": %s: %d", ErrFile, ErrLn);
 		if (errno > 0)
-			printf(": %s", strerror(errno));
+			fprintf(stream, ": %s", strerror(errno));
 		break;
 	case ERR_INVFLAG:
-		printf(": '%c'", ErrStr[ErrPos]);
+		fprintf(stream, ": '%c'", ErrStr[ErrPos]);
 		break;
 	case ERR_INVARG:
-		printf(": " SIZE_FMT, ErrPos);
+		fprintf(stream, ": " SIZE_FMT, ErrPos);
 		break;
-	case ERR_SYNTAX:
-		printf(": ");
-		fprint(ErrStr, ErrPos, ErrPos, F_UND);
+	case ERR_SYNTAX:	// Input with span underlined
+		fputs(": ", stream);
+		fwrite(ErrStr, 1, ErrPos, stream);
+		fputs(F_UND, stream);
+		fwrite(ErrStr + ErrPos, 1, ErrLen, stream);
+		fputs(F_CLR, stream);
+		fputs(ErrStr + ErrPos + ErrLen, stream);
 		break;
 	}
-	putchar('\n');
+	putc('\n', stream);
 }
 
 void setinv(const char *str, size_t pos) {
 	ErrPos = pos;
 	if (str) {
-		if(ErrStr)
-			free(ErrStr);
-		if (!(ErrStr = strdup(str)))
-			setstat(ERR_INTERNAL);
+		ErrStr = str;
+		ErrLen = 1;
 	}
+}
+
+void setspan(const char *str, size_t pos, size_t len) {
+	ErrStr = str;
+	ErrPos = pos;
+	ErrLen = len;
 }
\ No newline at end of file
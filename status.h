@@ -2,6 +2,7 @@
 #define STATUS_H
 
 #include <stddef.h>	// size_t
+#include <stdio.h>	// FILE
 #include <stdlib.h>	// atexit()
 #include <string.h>	// strdup()
 #include "global.h"	// ssize_t
@@ -15,22 +16,41 @@
 	}
 
 enum ErrorStatus {ERR_INTERNAL = 1, ERR_INVFLAG, ERR_INVARG, ERR_INVDEC, ERR_SYNTAX, ERR_OVERFLOW,
-				  ERR_MISSOPER, ERR_DIVZERO, ERR_MODULO, ERR_IMAGINARY, ERR_INPUTSIZE};
+				  ERR_MISSOPER, ERR_DIVZERO, ERR_MODULO, ERR_IMAGINARY, ERR_INPUTSIZE, ERR_MEMLIMIT,
+				  ERR_SHAPE, ERR_CANCELLED};
 
-extern char *ErrFile;	// File in which error occured
-extern char *ErrStr;	// String containing invalid syntax
-extern int ErrLn;		// Line at which internal error occured
-extern int ErrStat;		// Error status
-extern size_t ErrPos;	// Index in ErrStr where syntax is invalid
+/* Error record, set without allocating
+ * ErrStr refers to the input in error, which must outlive any call to pstatus() */
 
-/* Frees error string buffer */
+extern char *ErrFile;		// File in which error occured
+extern const char *ErrStr;	// String containing invalid syntax, not owned
+extern int ErrLn;			// Line at which internal error occured
+extern int ErrStat;			// Error status
+extern size_t ErrPos;		// Index in ErrStr where syntax is invalid
+extern size_t ErrLen;		// Length of invalid span in ErrStr
+
+/* Clears error record */
 extern void clrstat(void);
 
-/* Prints message according to error status */
+/* Returns message describing error status */
+extern const char *strstat(int stat);
+
+/* Prints message according to error status
+ * Prints one JSON object instead if Flags.json is set */
 extern void pstatus(void);
 
-/* Sets invalid str and position
+/* Writes message to stream, as pstatus() prints it */
+extern void fstatus(FILE *stream)
+attribute(__nonnull__(1));
+
+/* Sets invalid string and position of one-character span
+ * String is referred to, not copied
  * Pass string as NULL to omit */
 extern void setinv(const char *str, size_t pos);
 
+/* Sets invalid string and span of given length at position, such as a whole number or name
+ * String is referred to, not copied */
+extern void setspan(const char *str, size_t pos, size_t len)
+attribute(__nonnull__(1));
+
 #endif // #ifndef STATUS_H
\ No newline at end of file
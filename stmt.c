@@ -0,0 +1,269 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+#include "decimal.h"
+#include "global.h"
+#include "mem.h"
+#include "parse.h"
+#include "status.h"
+#include "stmt.h"
+#include "util.h"
+#include "vec.h"
+
+struct Variable {
+	char *name;
+	char *val;	// Full-precision result
+};
+
+static struct Variable *Vars = NULL;
+static size_t NVars = 0, VarCap = 0;
+static size_t Mark = SIZE_MAX;	// Variables from here on are undone by undovars(), SIZE_MAX if unmarked
+
+/* Returns true if name begins at position, rather than the exponent of a number */
+static bool isname(const char *str, size_t pos) {
+	return (isalpha(str[pos]) || str[pos] == '_') && !(pos && (isdigit(str[pos - 1]) || str[pos - 1] == '.'));
+}
+
+static size_t namelen(const char *str) {
+	size_t len = 0;
+
+	while (isalnum(str[len]) || str[len] == '_')	len++;
+	return len;
+}
+
+/* Returns latest variable of name, which shadows any assigned before mark */
+static struct Variable *getvar(const char *name, size_t len) {
+	for (size_t index = NVars; index; index--)
+		if (!strncmp(Vars[index - 1].name, name, len) && !Vars[index - 1].name[len])
+			return &Vars[index - 1];
+	return NULL;
+}
+
+/* Assigns value to variable, creating it if needed, or if it was assigned before mark
+ * Returns false on failure */
+static bool setvar(const char *name, size_t len, const char *val) {
+	struct Variable *var = getvar(name, len), *swap;
+	char *copy = strdup(val);
+
+	if (!copy) {
+		setstat(ERR_INTERNAL);
+		return false;
+	}
+	if (var && (Mark == SIZE_MAX || var - Vars >= Mark)) {
+		free(var->val);
+		var->val = copy;
+		return true;
+	}
+	if (NVars == VarCap) {
+		if (!(swap = realloc(Vars, (VarCap = VarCap ? VarCap * 2 : 16) * sizeof(struct Variable)))) {
+			free(copy);
+			setstat(ERR_INTERNAL);
+			return false;
+		}
+		Vars = swap;
+	}
+	if (!(Vars[NVars].name = strndup(name, len))) {
+		free(copy);
+		setstat(ERR_INTERNAL);
+		return false;
+	}
+	Vars[NVars++].val = copy;
+	return true;
+}
+
+/* Returns new, malloc'd copy of statement with each variable replaced by its parenthesised value
+ * Returns NULL on failure */
+static char *substitute(const char *input, const char *stmt, size_t len) {
+	struct Variable *var;
+	size_t size = len + 1, name, index, out = 0;
+	char *expr;
+
+	for (index = 0; index < len; index++) {	// Check names and measure result
+		if (!isname(stmt, index))
+			continue;
+		name = namelen(stmt + index);
+		if (!(var = getvar(stmt + index, name))) {
+			setstat(ERR_SYNTAX);
+			setspan(input, stmt - input + index, name);
+			return NULL;
+		}
+		size += strlen(var->val) + 2 - name;
+		index += name - 1;
+	}
+	if (!(expr = xmalloc(size)))
+		return NULL;
+	for (index = 0; index < len; index++) {
+		if (!isname(stmt, index)) {
+			expr[out++] = stmt[index];
+			continue;
+		}
+		name = namelen(stmt + index);
+		var = getvar(stmt + index, name);
+		expr[out++] = '(';
+		strcpy(expr + out, var->val);
+		out += strlen(var->val);
+		expr[out++] = ')';
+		index += name - 1;
+	}
+	expr[out] = '\0';
+	return expr;
+}
+
+/* Returns position in statement of character at given position in its substituted copy */
+static size_t mappos(const char *stmt, size_t pos) {
+	size_t index = 0, out = 0, name, val;
+
+	while (out < pos && stmt[index]) {
+		if (isname(stmt, index)) {
+			name = namelen(stmt + index);
+			val = strlen(getvar(stmt + index, name)->val) + 2;
+			if (pos < out + val)
+				return index;	// Within value of variable
+			out += val;
+			index += name;
+		} else
+			out++, index++;
+	}
+	return index;
+}
+
+/* Evaluates statement at full precision, once for all identical statements
+ * Returns NULL on failure */
+static char *evalstmt(const char *expr) {
+	char *key, *val;
+
+	if (!(key = xmalloc(strlen(expr) + 3)))
+		return NULL;
+	strcat(strcat(strcpy(key, "("), expr), ")");	// Never matches an innermost group
+	if ((val = getcache(key)) || !(val = parse(expr, MaxDec, NULL))) {
+		xfree(key);
+		return val;
+	}
+	putcache(key, val);	// Failure only costs a future hit
+	xfree(key);
+	return val;
+}
+
+/* Returns value rounded to given decimals, as printed
+ * Frees original value
+ * Returns NULL on failure */
+static char *roundval(char *val, unsigned sig) {
+	char *swap = val;
+
+	if (!isvec(val))	// Fixed-point results are already at their scale
+		return Flags.fixed ? val : roundnum(val, sig);
+	val = parse_vec(swap, Flags.fixed ? DecScale : sig);	// Each element
+	xfree(swap);
+	return val;
+}
+
+/* Appends string to result, growing it as needed
+ * Returns false on failure */
+static bool append(char **result, size_t *len, const char *str) {
+	char *swap = xrealloc(*result, *len + strlen(str) + 1);
+
+	if (!swap)
+		return false;
+	strcpy(swap + *len, str);
+	*len += strlen(str);
+	*result = swap;
+	return true;
+}
+
+void clrvars(void) {
+	for (size_t index = 0; index < NVars; index++) {
+		free(Vars[index].name);
+		free(Vars[index].val);
+	}
+	free(Vars);
+	Vars = NULL;
+	NVars = VarCap = 0;
+	Mark = SIZE_MAX;
+}
+
+void markvars(void) {
+	Mark = NVars;
+}
+
+void undovars(void) {
+	if (Mark == SIZE_MAX)
+		return;
+	for (; NVars > Mark; NVars--) {
+		free(Vars[NVars - 1].name);
+		free(Vars[NVars - 1].val);
+	}
+	Mark = SIZE_MAX;
+}
+
+bool isstmts(const char *input) {
+	for (size_t index = 0; input[index]; index++)
+		if (input[index] == STMT_SEP || input[index] == '=' || isname(input, index))
+			return true;
+	return false;
+}
+
+char *parse_line(const char *input, unsigned sig) {
+	return isstmts(input) ? parse_stmts(input, sig) : parse(input, sig, NULL);
+}
+
+char *parse_stmts(const char *input, unsigned sig) {
+	const char *stmt, *end, *next, *name;	// Statement, its end, and the separator after it
+	char *expr, *val, *result = NULL;
+	size_t len = 0, nlen = 0, skip;
+
+	for (stmt = input; *stmt; stmt = *next ? next + 1 : next) {
+		if (!(next = strchr(stmt, STMT_SEP)))
+			next = stmt + strlen(stmt);
+		end = next;
+		stmt += strspn(stmt, " \t");
+		name = NULL;
+		if (isname(stmt, 0)) {	// Assignment?
+			nlen = namelen(stmt);
+			skip = nlen + strspn(stmt + nlen, " \t");
+			if (stmt[skip] == '=') {
+				name = stmt;
+				stmt += skip + 1;
+			}
+		}
+		while (end > stmt && isspace(end[-1]))	end--;
+		if (stmt >= end) {	// Empty statement
+			if (!name)
+				continue;
+			setstat(ERR_MISSOPER);
+			goto fail;
+		}
+		if (!(expr = substitute(input, stmt, end - stmt)))
+			goto fail;
+		if (!(val = evalstmt(expr))) {
+			if (ErrStr == expr) {	// Refer to input, which outlives this copy
+				ErrStr = input;
+				ErrPos = stmt - input + mappos(stmt, ErrPos);
+			}
+			xfree(expr);
+			goto fail;
+		}
+		xfree(expr);
+		for (size_t vlen = strlen(val); vlen && isspace(val[vlen - 1]); )	// Left by collapsed parentheses
+			val[--vlen] = '\0';
+		if (name && !setvar(name, nlen, val)) {
+			xfree(val);
+			goto fail;
+		}
+		if (len && !append(&result, &len, "; ") ||
+			name && (!append(&result, &len, getvar(name, nlen)->name) || !append(&result, &len, " = ")) ||
+			!(val = roundval(val, sig)) ||
+			!append(&result, &len, val)) {
+			xfree(val);
+			goto fail;
+		}
+		xfree(val);
+	}
+	if (!result && !(result = xcalloc(1, sizeof(char))))	// Only empty statements
+		return NULL;
+	return result;
+fail:
+	xfree(result);
+	return NULL;
+}
\ No newline at end of file
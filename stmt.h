@@ -0,0 +1,41 @@
+#ifndef STMT_H
+#define STMT_H
+
+#include <stdbool.h>	// bool
+#include "global.h"		// attribute()
+
+/* Statements are expressions separated by ';', each optionally preceded by 'name ='
+ * Names begin with a letter or underscore, followed by letters, digits or underscores
+ * Variables keep their full-precision value for the rest of the session */
+
+#define STMT_SEP	';'
+
+/* Frees all variables */
+extern void clrvars(void);
+
+/* Marks variables as they are, so that assignments made after are undone by undovars()
+ * Until then, variables assigned before the mark are shadowed rather than changed */
+extern void markvars(void);
+
+/* Undoes assignments made since markvars() */
+extern void undovars(void);
+
+/* Returns true if input holds more than a single expression */
+extern bool isstmts(const char *input)
+attribute(__nonnull__(1));
+
+/* Evaluates line of input as entered: as statements if it holds any, otherwise as one expression
+ * On success, result must be freed
+ * Returns NULL on failure */
+extern char *parse_line(const char *input, unsigned sig)
+attribute(__warn_unused_result__, __nonnull__(1));
+
+/* Evaluates each statement, substituting variables assigned by earlier ones
+ * Identical statements and parenthesised subexpressions are evaluated once, through the subexpression cache
+ * Returns results joined by "; ", with assignments printed as 'name = value'
+ * On success, result must be freed
+ * Returns NULL on failure */
+extern char *parse_stmts(const char *input, unsigned sig)
+attribute(__warn_unused_result__, __nonnull__(1));
+
+#endif // #ifndef STMT_H
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "cache.h"
+#include "decimal.h"
+#include "global.h"
+#include "mem.h"
+#include "oper.h"
+#include "parse.h"
+#include "stats.h"
+#include "status.h"
+#include "task.h"
+#include "util.h"
+#include "vec.h"
+
+/* Sets up innermost group that is left, or whole expression once none are
+ * Groups already cached are replaced at once
+ * Returns false on failure */
+static bool nextgroup(struct Task *task) {
+	char *close, *cached;
+
+	while ((close = strchr(task->expr, ')'))) {
+		task->high = close - task->expr;
+		for (task->low = task->high; task->expr[task->low] != '('; task->low--);	// Parentheses were checked to match
+		task->expr[task->low] = toast(task->expr, task->low) ? '*' : ' ';
+		task->expr[task->high] = toast(task->expr, task->high) ? '*' : ' ';
+		if (task->low + 1 >= task->high - 1)	// Nothing inside
+			continue;
+		if (!(task->key = popsub(task->expr, task->low + 1, task->high - 1)))
+			return false;
+		if (!(cached = getcache(task->key)))
+			return (task->sub = xstrdup(task->key));
+		xfree(task->key);
+		task->key = NULL;
+		if (!(task->expr = pushsub(task->expr, cached, task->low + 1, task->high - 1)))
+			return false;
+	}
+	task->sub = task->expr;
+	task->expr = NULL;
+	return true;
+}
+
+/* Puts result of finished group back into expression, or rounds result of whole expression
+ * Returns false on failure */
+static bool endgroup(struct Task *task) {
+	char *swap;
+
+	if (task->expr) {
+		putcache(task->key, task->sub);	// Failure only costs a future hit
+		xfree(task->key);
+		task->key = NULL;
+		task->expr = pushsub(task->expr, task->sub, task->low + 1, task->high - 1);
+		task->sub = NULL;
+		return task->expr;
+	}
+	swap = task->sub;
+	task->sub = NULL;
+	if (!(task->result = staged(STG_PPRINT, pprint(swap)))) {
+		xfree(swap);
+		return false;
+	}
+	xfree(swap);
+	task->result = Flags.fixed ? staged(STG_ROUND, rounddec(task->result)) : staged(STG_ROUND, roundnum(task->result, task->sig));
+	return task->result;
+}
+
+double task_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+bool task_start(struct Task *task, const char *expr, unsigned sig) {
+	*task = (struct Task) {.sig = sig > MaxDec ? MaxDec : sig, .pass = NOPER};
+	mem_begin();
+	if (Flags.rational || isvec(expr)) {
+		task->whole = true;
+		task->sig = sig;
+	} else if (staged(STG_SYNTAX, chk_syntax(expr)) != PASS || staged(STG_PARENTH, chk_parenth(expr)) != PASS)
+		return false;
+	if (!(task->expr = xstrdup(expr)))
+		return false;
+	task->held = mem_held();
+	return true;
+}
+
+/* Returns true if task is cancelled or past its deadline, setting error status */
+static bool cancelled(const struct Task *task) {
+	if (task->cancel && atomic_load(task->cancel) || task->deadline && task_now() >= task->deadline) {
+		setstat(ERR_CANCELLED);
+		return true;
+	}
+	return false;
+}
+
+/* Continues evaluation, see task_step() */
+static enum TaskStatus step(struct Task *task, unsigned passes) {
+	const struct Operator *oper;
+
+	if (task->whole) {
+		if (task->deadline) {	// Could not be kept, since nothing stops a whole evaluation once begun
+			setstat(ERR_CANCELLED);
+			return TASK_FAIL;
+		}
+		if (cancelled(task))
+			return TASK_FAIL;
+		return (task->result = parse(task->expr, task->sig, NULL)) ? TASK_DONE : TASK_FAIL;
+	}
+	while (true) {
+		if (!task->sub && !nextgroup(task))
+			return TASK_FAIL;
+		if (task->pass == NOPER) {
+			if (!(task->present = parse_round(task->sub))) {	// Group is a single value
+				if (!endgroup(task))
+					return TASK_FAIL;
+				if (task->result)
+					return TASK_DONE;
+				continue;
+			}
+			task->pass = 0;
+		}
+		oper = &Opers[task->pass];
+		if (ispass(task->present, oper)) {
+			if (!passes)
+				return TASK_YIELD;
+			if (cancelled(task))
+				return TASK_FAIL;
+			if (!staged(oper->stage, parse_oper(&task->sub, oper)))
+				return TASK_FAIL;
+			passes--;
+		}
+		task->pass++;	// Reaching NOPER begins next round
+	}
+}
+
+enum TaskStatus task_step(struct Task *task, unsigned passes) {
+	enum TaskStatus status;
+
+	if (task->result)
+		return TASK_DONE;
+	if (task->stat) {
+		ErrStat = task->stat;
+		return TASK_FAIL;
+	}
+	ErrStat = 0;	// Not left over from another task
+	mem_resume(task->held);
+	if ((status = step(task, passes)) == TASK_FAIL)
+		task->stat = ErrStat > 0 ? ErrStat : ERR_INTERNAL;
+	task->held = mem_held();
+	return status;
+}
+
+void task_free(struct Task *task) {
+	xfree(task->expr);
+	xfree(task->sub);
+	xfree(task->key);
+	xfree(task->result);
+	*task = (struct Task) {.pass = NOPER};
+}
\ No newline at end of file
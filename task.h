@@ -0,0 +1,56 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <stdatomic.h>	// _Atomic
+#include <stdbool.h>	// bool
+#include <stddef.h>		// size_t
+#include "global.h"		// attribute()
+
+/* Resumable evaluation
+ * Between operator passes, the whole state of the text evaluator is the expression as rewritten so far,
+ * so an evaluation can stop after any pass and continue later, from an event loop, without a thread of its own
+ * Vector and rational expressions are not rewritten as text, and are evaluated whole by the first step,
+ * which cannot be stopped once begun, so such a task with a deadline is cancelled instead
+ * Tasks may be interleaved: each is held to the memory budget on its own, and keeps its error status once failed */
+
+enum TaskStatus {TASK_YIELD, TASK_DONE, TASK_FAIL};
+
+struct Task {
+	char *expr;		// Expression as rewritten so far, NULL once only sub remains
+	char *sub;		// Group being evaluated, or NULL between groups
+	char *key;		// Group as written, to cache its result under
+	size_t low, high;	// Parentheses of group
+	unsigned sig;
+	unsigned present;	// Operators of current round of passes
+	unsigned pass;		// Next operator of round, NOPER before the round begins
+	bool whole;			// Evaluated in one step?
+	int stat;			// Error status once failed, restored by later steps
+	size_t held;		// Bytes held between steps, counted against memory budget
+
+	/* Set by caller, and may be changed between steps */
+	double deadline;			// Time from task_now() at which evaluation is cancelled, 0 for none
+	const _Atomic bool *cancel;	// Cancels evaluation once true, may be set from another thread, or NULL
+
+	char *result;	// Once done, result to be taken and freed by caller
+};
+
+/* Returns monotonic time in microseconds, for deadlines */
+extern double task_now(void);
+
+/* Begins evaluation of expression, checking its syntax
+ * Returns false on failure */
+extern bool task_start(struct Task *task, const char *expr, unsigned sig)
+attribute(__warn_unused_result__, __nonnull__(1, 2));
+
+/* Continues evaluation for at most given number of operator passes, checking for cancellation before each,
+ * and before a task evaluated whole, which fails at once if it has a deadline
+ * Returns TASK_YIELD if work remains, TASK_DONE once task->result is set,
+ * or TASK_FAIL with error status set, ERR_CANCELLED if cancelled or past deadline */
+extern enum TaskStatus task_step(struct Task *task, unsigned passes)
+attribute(__nonnull__(1));
+
+/* Frees task, whether finished or not, including any result not taken */
+extern void task_free(struct Task *task)
+attribute(__nonnull__(1));
+
+#endif // #ifndef TASK_H
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "global.h"
+#include "status.h"
+#include "trace.h"
+
+#if LINUX
+#include <sys/syscall.h>
+#endif // #if LINUX
+
+struct TraceEvent {
+	const char *name;
+	double begin, end;			// Microseconds
+	double lval, rval, result;
+	size_t before, after;		// Buffer sizes
+	bool is_oper;
+};
+
+/* Each thread fills its own buffer without locking, only writing it out takes the file lock */
+struct TraceBuffer {
+	struct TraceEvent events[TRACE_EVENTS];
+	size_t count;
+};
+
+bool Tracing = false;
+
+static FILE *TraceFile = NULL;
+static long Owner = 1;		// Process that opened file, the only one to complete it
+static bool First = true;	// No event written yet?
+static _Thread_local struct TraceBuffer Buffer;
+
+/* Prints JSON number, or null if not finite */
+static void pnum(const char *key, double x) {
+	if (isfinite(x))
+		fprintf(TraceFile, ",\"%s\":%.17g", key, x);
+	else
+		fprintf(TraceFile, ",\"%s\":null", key);
+}
+
+/* Writes buffered events of calling thread */
+static void flush(void) {
+	struct TraceEvent *event;
+	long pid = 1, tid = 1;
+
+#if UNIX
+	pid = getpid();
+	tid = pid;
+#endif // #if UNIX
+#if LINUX
+	tid = syscall(SYS_gettid);
+#endif // #if LINUX
+	flockfile(TraceFile);
+	for (size_t index = 0; index < Buffer.count; index++) {
+		event = &Buffer.events[index];
+		fprintf(TraceFile, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,\"args\":{",
+				First ? "" : ",", event->name, event->is_oper ? "oper" : "step",
+				event->begin, event->end - event->begin, pid, tid);
+		fprintf(TraceFile, "\"before\":" SIZE_FMT ",\"after\":" SIZE_FMT, event->before, event->after);
+		if (event->is_oper) {
+			pnum("lval", event->lval);
+			pnum("rval", event->rval);
+			pnum("result", event->result);
+		}
+		fputs("}}", TraceFile);
+		First = false;
+	}
+	funlockfile(TraceFile);
+	Buffer.count = 0;
+}
+
+/* Returns next free event of calling thread, writing buffer out if full */
+static struct TraceEvent *newevent(void) {
+	if (Buffer.count == TRACE_EVENTS)
+		flush();
+	return &Buffer.events[Buffer.count++];
+}
+
+bool trace_open(const char *path) {
+	if (!(TraceFile = fopen(path, "w"))) {
+		setstat(ERR_INTERNAL);
+		return false;
+	}
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", TraceFile);
+	fflush(TraceFile);	// Otherwise a forked child inherits header in its buffer and writes it again
+#if UNIX
+	Owner = getpid();
+#endif // #if UNIX
+	Tracing = true;
+	return true;
+}
+
+void trace_close(void) {
+	if (!TraceFile)
+		return;
+#if UNIX
+	if (getpid() != Owner)	// Forked child exiting normally
+		return;
+#endif // #if UNIX
+	flush();
+	fputs("\n]}\n", TraceFile);
+	fclose(TraceFile);
+	TraceFile = NULL;
+	Tracing = false;
+}
+
+double trace_now(void) {
+	struct timespec ts;
+
+	if (!Tracing)
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void trace_oper(const char *oper, double lval, double rval, double result, size_t before, size_t after, double begin) {
+	struct TraceEvent *event;
+
+	if (!Tracing)
+		return;
+	event = newevent();
+	*event = (struct TraceEvent) {oper, begin, trace_now(), lval, rval, result, before, after, true};
+}
+
+void trace_step(const char *name, size_t before, size_t after, double begin) {
+	struct TraceEvent *event;
+
+	if (!Tracing)
+		return;
+	event = newevent();
+	*event = (struct TraceEvent) {name, begin, trace_now(), 0, 0, 0, before, after, false};
+}
\ No newline at end of file
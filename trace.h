@@ -0,0 +1,32 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>	// bool
+#include <stddef.h>		// size_t
+#include "global.h"		// attribute()
+
+#define TRACE_EVENTS	1024	// Events buffered per thread before being written
+
+extern bool Tracing;	// Recording rewrite steps?
+
+/* Starts writing Chrome/Perfetto trace of rewrite steps to file
+ * Returns false on failure */
+extern bool trace_open(const char *path)
+attribute(__nonnull__(1));
+
+/* Writes buffered events of calling thread and completes trace file
+ * Does nothing in processes forked after trace_open(), which must not trace */
+extern void trace_close(void);
+
+/* Returns timestamp, in microseconds, to be passed as beginning of event */
+extern double trace_now(void);
+
+/* Records operator reduction, with buffer size before and after */
+extern void trace_oper(const char *oper, double lval, double rval, double result, size_t before, size_t after, double begin)
+attribute(__nonnull__(1));
+
+/* Records named rewrite step, such as a parenthesis collapse or splice, with buffer size before and after */
+extern void trace_step(const char *name, size_t before, size_t after, double begin)
+attribute(__nonnull__(1));
+
+#endif // #ifndef TRACE_H
\ No newline at end of file
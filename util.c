@@ -8,8 +8,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include "global.h"
+#include "mem.h"
+#include "oper.h"
 #include "parse.h"
 #include "status.h"
+#include "trace.h"
 #include "util.h"
 
 void fprint(const char *str, size_t begin, size_t end, format_t fmt) {
@@ -33,29 +36,64 @@ void fprint(const char *str, size_t begin, size_t end, format_t fmt) {
 	}
 }
 
-char *dtos(double x, unsigned sig) {
+/* Rounds number string in place as roundnum() does, given room for one more character
+ * Returns new length of string */
+static size_t roundbuf(char *str, unsigned sig) {
+	char *next;
+	size_t len = strlen(str), digitpos, sign;
+	ssize_t index;
+
+	if (!strchr(str, '.'))	// Whole number, rounding not necessary
+		return len;
+	digitpos = strcspn(str, ".") + sig - (sig == 0);
+	if (digitpos >= len - 1)	// Fewer decimals than requested, rounding not necessary
+		return len;
+	next = &str[digitpos + 1];
+	while (*next == '.')	next++;
+	if (*next >= '5') {
+		for (index = digitpos; index >= 0; index--) {
+			if (!isdigit(str[index]))
+				continue;
+			if (++str[index] <= '9')
+				break;
+			str[index] = '0';
+		}
+		if (index == -1) {	// Carryover, after sign if present
+			sign = strspn(str, "+-");
+			memmove(str + sign + 1, str + sign, digitpos + 1 - sign);
+			str[sign] = '1';
+			digitpos++;
+		}
+	}
+	str[digitpos + 1] = '\0';
+	return digitpos + 1;
+}
+
+/* Writes string representation of double into buffer of DTOS_MAX characters
+ * Returns length of string, or 0 on failure */
+static size_t dtos_into(double x, unsigned sig, char *string) {
 	bool only_decimal, is_whole;
-	char *string, digit;
+	char digit;
 	int exponent, abs_exp;
-	size_t nwplaces, ndplaces, reqsize = 0, index = 0;
+	size_t nwplaces, ndplaces, reqsize = 0, expsize = 0, index = 0;
 	double mantissa;
 
 	if (isnan(x)) {
 		setstat(ERR_IMAGINARY);
-		return NULL;
+		return 0;
 	}
 	mantissa = getmant(x);
 	exponent = getexp(x);
 	abs_exp = abs(exponent);
 	if (abs_exp > MantSize || isinf(x)) {
 		setstat(ERR_OVERFLOW);
-		return NULL;
+		return 0;
 	}
 	if (abs_exp > MantSize - 1) {
 		x = mantissa;
-		reqsize +=
+		expsize =
 			1					// 'E'
-			+ exponent < 0		// Negative sign, if present
+			+ (exponent < 0)	// Negative sign, if present
 			+ nwhole(exponent);	// Exponent
 	}
 	only_decimal = x < 1 && x > -1 && x;
@@ -73,11 +111,7 @@ char *dtos(double x, unsigned sig) {
 		+ !is_whole		// Decimal point
 		+ only_decimal	// Leading zero, if present
 		+ 1;			// Negative/Positive sign
-	string = (char *) calloc(reqsize + 1 /* Null character */, sizeof(char));
-	if (!string) {
-		setstat(ERR_INTERNAL);
-		return NULL;
-	}
+	memset(string, '\0', reqsize + expsize + 1 /* Null character */);
 	string[index++] = x < 0 ? '-' : '+';	// Positive sign required for proper parse() functionality
 	if (only_decimal) {
 		string[index++] = '0';
@@ -100,11 +134,51 @@ char *dtos(double x, unsigned sig) {
 			string[index++] = digit;
 		string[index++] = getdigit(exponent, 0);
 	}
+	return strlen(string);
+}
+
+char *dtos(double x, unsigned sig) {
+	char *string = (char *) xmalloc(DTOS_MAX * sizeof(char));
+
+	if (string && !dtos_into(x, sig, string)) {
+		xfree(string);
+		return NULL;
+	}
+	return string;
+}
+
+char *dtosv(const double *x, size_t n, unsigned sig, const char *sep) {
+	char *string, *num;
+	size_t seplen = strlen(sep), len = 0, numlen;
+
+	if (n > (SIZE_MAX - 1) / (DTOS_MAX + 1 + seplen)) {
+		setstat(ERR_MEMLIMIT);
+		return NULL;
+	}
+	string = (char *) xmalloc((n * (DTOS_MAX + 1 /* Carryover */ + seplen) + 1) * sizeof(char));
+	if (!string)
+		return NULL;
+	for (size_t index = 0; index < n; index++) {
+		if (index) {
+			memcpy(string + len, sep, seplen);
+			len += seplen;
+		}
+		num = string + len;
+		if (!(numlen = dtos_into(x[index], MaxDec, num))) {
+			xfree(string);
+			return NULL;
+		}
+		if (*num == '+')	// As pprint()
+			memmove(num, num + 1, numlen--);
+		len += roundbuf(num, sig);
+	}
+	string[len] = '\0';
 	return string;
 }
 
 char *getln(size_t limit) {
-	char *input = malloc(sizeof(char)), chr;
+	char *input = malloc(sizeof(char));
+	int chr;
 	size_t memsize = 1, index = 0;
 
 	if (!input) {
@@ -112,7 +186,8 @@ char *getln(size_t limit) {
 		return NULL;
 	}
 	do {
-		chr = getchar();
+		if ((chr = getchar()) == EOF)	// Ends line, then ends input with an empty line
+			chr = '\n';
 		if (index == memsize) {
 			if (!(input = (char *) realloc(input, (memsize *= 2) * sizeof(char)))) {
 				setstat(ERR_INTERNAL);
@@ -132,27 +207,28 @@ char *getln(size_t limit) {
 	}
 	input[index] = '\0';
 	if (chr != '\n')
-		while ((chr = getchar()) != '\n');	// Flush stdin if needed
+		while ((chr = getchar()) != '\n' && chr != EOF);	// Flush stdin if needed
 	return input;
 }
 
 char *popsub(const char *str, size_t low, size_t high) {
 	char *sub;
+	double begin = trace_now();
 
 	if (low >= strlen(str) || high >= strlen(str) || low > high) {
 		setstat(ERR_INTERNAL);
 		return NULL;
 	}
-	sub = (char *) calloc(
+	sub = (char *) xcalloc(
 		high - low + 1	// # of characters being removed
 		+ 1,			// Null character
 		sizeof(char));
-	if (!sub) {
-		setstat(ERR_INTERNAL);
+	if (!sub)
 		return NULL;
-	}
 	for (size_t index_old = low, index_new = 0; index_old <= high; index_old++, index_new++)
 		sub[index_new] = str[index_old];
+	if (Tracing)
+		trace_step("popsub", strlen(str), high - low + 1, begin);
 	return sub;
 }
 
@@ -162,21 +238,17 @@ char *pprint(const char *string) {
 
 	if (!string)
 		return NULL;
-	if (!(str = strdup(string))) {
-		setstat(ERR_INTERNAL);
+	if (!(str = xstrdup(string)))
 		return NULL;
-	}
 	ignore = strspn(str, " ");
 	if (str[ignore] == '+')
 		ignore++;
 	if (ignore > 0) {
 		swap = str;
-		str = strdup(str + ignore);
-		free(swap);
-		if (!str) {
-			setstat(ERR_INTERNAL);
+		str = xstrdup(str + ignore);
+		xfree(swap);
+		if (!str)
 			return NULL;
-		}
 	}
 	return str;
 }
@@ -184,23 +256,23 @@ char *pprint(const char *string) {
 char *pushsub(char *str, char *sub, size_t low, size_t high) {
 	char *result;
 	size_t index_old, index_new;
+	double begin = trace_now();
 
 	if (low >= strlen(str) || high >= strlen(str) || low > high) {
-		free(str);
-		free(sub);
+		xfree(str);
+		xfree(sub);
 		setstat(ERR_INTERNAL);
 		return NULL;
 	}
-	result = (char *) calloc(
+	result = (char *) xcalloc(
 		strlen(str)			// Original length
 		- (high - low + 1)	// # of characters being removed
 		+ strlen(sub)		// Substring length
 		+ 1,				// Null character
 		sizeof(char));
 	if (!result) {
-		free(str);
-		free(sub);
-		setstat(ERR_INTERNAL);
+		xfree(str);
+		xfree(sub);
 		return NULL;
 	}
 	for (index_new = 0; index_new < low; index_new++)
@@ -209,8 +281,10 @@ char *pushsub(char *str, char *sub, size_t low, size_t high) {
 		result[index_new] = sub[index_old];	// Integrate substring
 	for (index_old = high + 1; index_old < strlen(str); index_old++, index_new++)
 		result[index_new] = str[index_old];	// Add rest of old string
-	free(str);
-	free(sub);
+	if (Tracing)
+		trace_step("pushsub", strlen(str), index_new, begin);
+	xfree(str);
+	xfree(sub);
 	return result;
 }
 
@@ -225,6 +299,8 @@ char *roundnum(char *str, unsigned sig) {
 	if (!strchr(str, '.'))	// Whole numer, rounding not necessary
 		return str;
 	digitpos = strcspn(str, ".") + sig - (sig == 0);
+	if (digitpos >= strlen(str) - 1)	// Fewer decimals than requested, rounding not necessary
+		return str;
 	curr = &str[digitpos];
 	next = curr + 1;
 	while (*next == '.')	next++;
@@ -248,21 +324,22 @@ char *roundfrom(char *str, size_t digitpos, direct_t dir) {
 		}
 	}
 	swap = str;
-	str = (char *) calloc(
+	str = (char *) xcalloc(
 		digitpos + 1					// Characters being kept
 		+ (dir == UP && index == -1)	// Carryover, if present
 		+ 1, 							// Null character
 		sizeof(char));
 	if (!str) {
-		setstat(ERR_INTERNAL);
-		free(swap);
+		xfree(swap);
 		return NULL;
 	}
-	index = 0;
-	if (index == -1)
-		str[index++] = '1';	// Carryover
-	strncat(str, swap, digitpos + 1);
-	free(swap);
+	if (dir == UP && index == -1) {	// Carryover, after sign if present
+		strncat(str, swap, strspn(swap, "+-"));
+		strcat(str, "1");
+		strncat(str, swap + strspn(swap, "+-"), digitpos + 1 - strspn(swap, "+-"));
+	} else
+		strncat(str, swap, digitpos + 1);
+	xfree(swap);
 	return str;
 }
 
@@ -343,6 +420,22 @@ ssize_t chk_parenth(const char *expr) {
 	return PASS;
 }
 
+size_t toklen(const char *str, size_t pos) {
+	size_t len = 0;
+
+	if (isdigit(str[pos]) || str[pos] == '.') {	// Number, with any exponent
+		while (isnum(str[pos + len]) || isparity(str[pos + len]) && str[pos + len - 1] == 'E')	len++;
+		return len;
+	}
+	if (isalpha(str[pos]) || str[pos] == '_') {	// Name
+		while (isalnum(str[pos + len]) || str[pos + len] == '_')	len++;
+		return len;
+	}
+	if (ischr(str[pos], CHR_DOUBL) && str[pos + 1] == str[pos])
+		return 2;
+	return str[pos] != '\0';
+}
+
 ssize_t chk_syntax(const char *expr) {
 	char chr;
 	char next;			// Immediate next
@@ -370,22 +463,22 @@ ssize_t chk_syntax(const char *expr) {
 			if (chr == '(')
 				pcount = -1;
 		}
-		else if (strchr(ChrSets.doubl, chr) && (chr == last || chr == next )) {
+		else if (ischr(chr, CHR_DOUBL) && (chr == last || chr == next )) {
 			if (chr != doubl && ndouble ||							/* Double operator mismatch	  */
 			    isparity(chr) && (isdigit(lead) || lead == ')')) {	/* Increment/Decrement misuse */
 				setstat(ERR_SYNTAX);
-				setinv(expr, index);
+				setspan(expr, index, toklen(expr, index));
 				return index;
 			}
 			doubl = chr;
 			ndouble++;
 		}
-		else if (strchr(ChrSets.opers, chr)) {
+		else if (ischr(chr, CHR_OPER)) {
 			if (chr != singl && isparity(chr)) {	/* Allow for situations such as */
 				nsingle--;							/* '2/-2' without parentheses	*/
 				if (isparity(trail) && !isnum(lead)) {	// Catch unary operator misuse
 					setstat(ERR_SYNTAX);
-					setinv(expr, index);
+					setspan(expr, index, toklen(expr, index));
 					return index;
 				}
 
@@ -398,12 +491,12 @@ ssize_t chk_syntax(const char *expr) {
 		else if (chr == '.')
 			npoint++;
 		if (nsingle == 2 || ndouble == 3 ||	npoint == 2						||		/* Extra operator or comma */
-			!strchr(ChrSets.valid, chr) && !isspace(chr)					||		/* Invalid character	   */
+			!ischr(chr, CHR_VALID) && !isspace(chr)							||		/* Invalid character	   */
 			(isnum(chr) || chr == '(') && isnum(lead) && lead != last		||		/* Two #'s side-by-side    */
 			chr == ')' && isnum(trail) && trail != next						||		/*                         */
 			chr == 'E' && (!isnumer(last) || !isnumer(next))) {					/* Invalid sci. notation   */
 			setstat(ERR_SYNTAX);
-			setinv(expr, index);
+			setspan(expr, index, toklen(expr, index));
 			return index;
 		}
 		if (!isspace(chr))
@@ -485,15 +578,13 @@ double getval(char *expr, size_t operpos, direct_t dir) {
 		val_low = 0;
 	else if (chr == 0)		// Reached end of expression
 		val_high = strlen(expr) - 1;
-	if (!(valstr = popsub(expr, val_low, val_high))) {
-		free(expr);
-		return FAIL;
-	}
+	if (!(valstr = popsub(expr, val_low, val_high)))
+		return FAIL;	// Expression belongs to caller
 	if ((val = stod(valstr)) == FAIL) {
-		free(valstr);
+		xfree(valstr);
 		return FAIL;
 	}
-	free(valstr);
+	xfree(valstr);
 	return val;
 }
 
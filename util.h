@@ -9,6 +9,8 @@
 #include <stdint.h>		// intmax_t
 #include "global.h"		// ssize_t
 
+#define DTOS_MAX	32	// Longest string from dtos(), including null character
+
 /* Returns true if floating-point numbers are equal */
 #define isequal(x, y)	(fabs((x) - (y)) < FLT_EPSILON)
 
@@ -36,6 +38,13 @@ extern void fprint(const char *str, size_t begin, size_t end, format_t fmt);
 extern char *dtos(double x, unsigned sig)
 attribute(__warn_unused_result__);
 
+/* Returns null-terminated, malloc'd string of doubles, printed and rounded as parse() prints results, between separators
+ * Writes every number into one buffer, instead of allocating each
+ * On success, result must be freed
+ * Returns NULL on failure */
+extern char *dtosv(const double *x, size_t n, unsigned sig, const char *sep)
+attribute(__warn_unused_result__, __nonnull__(4));
+
 /* Returns null-terminated, malloc'd string input from stdin to a certain number of characters, including null character
  * On success, result must be freed, even when no input is given 
  * Returns NULL on failure */
@@ -105,6 +114,11 @@ attribute(__nonnull__(1));
 extern ssize_t chk_syntax(const char *expr)
 attribute(__nonnull__(1));
 
+/* Returns length of token at position, for error spans: a number, a name, a doubled operator, or one character
+ * Returns 0 at end of string */
+extern size_t toklen(const char *str, size_t pos)
+attribute(__nonnull__(1));
+
 /* Returns left- or right-hand limit of range of operation at operand position */
 extern ssize_t getlim(char *expr, size_t operpos, direct_t dir)
 attribute(__nonnull__(1));
@@ -0,0 +1,445 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+#include "mem.h"
+#include "oper.h"
+#include "parse.h"
+#include "status.h"
+#include "util.h"
+#include "vec.h"
+
+#define LANES		4	// Doubles per SIMD vector
+#define VEC_DEPTH	256	// Deepest accepted nesting of parentheses and brackets
+
+#if GNU
+typedef double v4d __attribute__((__vector_size__(LANES * sizeof(double))));
+
+/* Applies operator to whole SIMD vectors of both operands, repeating first element of either if not stepped */
+#define SIMD_LOOP(op)																	\
+	for (; index + LANES <= n; index += LANES)											\
+		store4(out + index, (xstep ? load4(x + index) : splat4(*x)) op (ystep ? load4(y + index) : splat4(*y)));
+#else
+#define SIMD_LOOP(op)
+#endif
+
+/* Applies operator to remaining elements */
+#define TAIL_LOOP(op)					\
+	for (; index < n; index++)			\
+		out[index] = x[xstep ? index : 0] op y[ystep ? index : 0];
+
+/* Scalar, vector or matrix */
+struct Tensor {
+	unsigned rank;		// 0, 1 or 2
+	size_t rows, cols;	// Scalars are 1 by 1, and vectors 1 by length
+	double *data;		// Row-major
+};
+
+struct Reader {
+	const char *expr, *pos;
+	unsigned depth;	// Open parentheses and brackets
+};
+
+#if GNU	// Macros, since passing vectors to functions depends on target
+#define load4(src)			({v4d x_; memcpy(&x_, (src), sizeof(x_)); x_;})	// Unaligned
+#define store4(dest, x)		({v4d x_ = (x); memcpy((dest), &x_, sizeof(x_));})
+#define splat4(x)			((v4d) {(x), (x), (x), (x)})
+#endif
+
+/* Allocates tensor of given shape
+ * Returns false on failure */
+static bool alloc(struct Tensor *t, unsigned rank, size_t rows, size_t cols) {
+	*t = (struct Tensor) {rank, rows, cols, NULL};
+	if (rows > SIZE_MAX / sizeof(double) / cols) {
+		setstat(ERR_MEMLIMIT);
+		return false;
+	}
+	return (t->data = xmalloc(rows * cols * sizeof(double))) != NULL;
+}
+
+static void drop(struct Tensor *t) {
+	xfree(t->data);
+	t->data = NULL;
+}
+
+/* Sets syntax error at current position, or at given opening parenthesis or bracket if input has ended */
+static void syntax(const struct Reader *rd, const char *open) {
+	size_t pos = (*rd->pos || !open ? rd->pos : open) - rd->expr;
+
+	setstat(ERR_SYNTAX);
+	setspan(rd->expr, pos, toklen(rd->expr, pos));
+}
+
+/* Applies +, -, * or / to n elements, stepping through either operand or repeating its first element */
+static void kernel(char oper, const double *x, bool xstep, const double *y, bool ystep, double *out, size_t n) {
+	size_t index = 0;
+
+	switch (oper) {
+	case '+':	SIMD_LOOP(+)	TAIL_LOOP(+)	break;
+	case '-':	SIMD_LOOP(-)	TAIL_LOOP(-)	break;
+	case '*':	SIMD_LOOP(*)	TAIL_LOOP(*)	break;
+	case '/':	SIMD_LOOP(/)	TAIL_LOOP(/)	break;
+	}
+}
+
+/* Returns sum of products of n elements */
+static double dot(const double *x, const double *y, size_t n) {
+	double sum = 0;
+	size_t index = 0;
+
+#if GNU
+	v4d even = {0}, odd = {0};	// Independent sums, so that additions overlap
+
+	for (; index + 2 * LANES <= n; index += 2 * LANES) {
+		even += load4(x + index) * load4(y + index);
+		odd += load4(x + index + LANES) * load4(y + index + LANES);
+	}
+	even += odd;
+	sum = even[0] + even[1] + even[2] + even[3];
+#endif
+	for (; index < n; index++)
+		sum += x[index] * y[index];
+	return sum;
+}
+
+/* Adds multiple of n elements to output */
+static void axpy(double a, const double *x, double *out, size_t n) {
+	size_t index = 0;
+
+#if GNU
+	v4d scale = splat4(a);
+
+	for (; index + LANES <= n; index += LANES)
+		store4(out + index, load4(out + index) + scale * load4(x + index));
+#endif
+	for (; index < n; index++)
+		out[index] += a * x[index];
+}
+
+/* Adds product of n by m matrix and m by p matrix to n by p matrix
+ * Works through tiles of VEC_BLOCK elements square, which stay in cache while they are reused */
+static void matmul(const double *a, const double *b, double *c, size_t n, size_t m, size_t p) {
+	size_t width;
+
+	for (size_t ii = 0; ii < n; ii += VEC_BLOCK)
+		for (size_t kk = 0; kk < m; kk += VEC_BLOCK)
+			for (size_t jj = 0; jj < p; jj += VEC_BLOCK) {
+				width = p - jj < VEC_BLOCK ? p - jj : VEC_BLOCK;
+				for (size_t i = ii; i < n && i < ii + VEC_BLOCK; i++)
+					for (size_t k = kk; k < m && k < kk + VEC_BLOCK; k++)
+						axpy(a[i * m + k], b + k * p + jj, c + i * p + jj, width);
+			}
+}
+
+/* Returns false if dimensions can not be broadcast together */
+static bool broadcast(size_t lhs, size_t rhs, size_t *dim) {
+	*dim = lhs == 1 ? rhs : lhs;
+	return lhs == rhs || lhs == 1 || rhs == 1;
+}
+
+/* Applies binary operator to each pair of elements, after broadcasting
+ * Returns false on failure */
+static bool elementwise(const char *oper, const struct Tensor *lhs, const struct Tensor *rhs, struct Tensor *res) {
+	const double *x, *y;
+	double *out;
+	size_t rows, cols;
+
+	if (!broadcast(lhs->rows, rhs->rows, &rows) || !broadcast(lhs->cols, rhs->cols, &cols)) {
+		setstat(ERR_SHAPE);
+		return false;
+	}
+	if (*oper == '/') {	// Kernel divides without checking
+		for (size_t index = 0; index < rhs->rows * rhs->cols; index++) {
+			if (!rhs->data[index]) {
+				setstat(ERR_DIVZERO);
+				return false;
+			}
+		}
+	}
+	if (!alloc(res, lhs->rank > rhs->rank ? lhs->rank : rhs->rank, rows, cols))
+		return false;
+	for (size_t row = 0; row < rows; row++) {
+		x = lhs->data + (lhs->rows == 1 ? 0 : row) * lhs->cols;
+		y = rhs->data + (rhs->rows == 1 ? 0 : row) * rhs->cols;
+		out = res->data + row * cols;
+		if (!oper[1] && strchr("+-*/", *oper)) {
+			kernel(*oper, x, lhs->cols != 1, y, rhs->cols != 1, out, cols);
+			continue;
+		}
+		for (size_t col = 0; col < cols; col++) {	// No kernel, one element at a time
+			if (!calc(oper, x[lhs->cols == 1 ? 0 : col], y[rhs->cols == 1 ? 0 : col], &out[col])) {
+				drop(res);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/* Multiplies vectors or matrices, x@y
+ * Returns false on failure */
+static bool product(const struct Tensor *lhs, const struct Tensor *rhs, struct Tensor *res) {
+	size_t inner = lhs->cols;
+
+	if (!lhs->rank || !rhs->rank || (rhs->rank == 1 ? rhs->cols : rhs->rows) != inner) {
+		setstat(ERR_SHAPE);
+		return false;
+	}
+	if (rhs->rank == 1) {	// Dot product with each row
+		if (!alloc(res, lhs->rank - 1, 1, lhs->rows))
+			return false;
+		for (size_t row = 0; row < lhs->rows; row++)
+			res->data[row] = dot(lhs->data + row * inner, rhs->data, inner);
+		return true;
+	}
+	if (!alloc(res, lhs->rank, lhs->rows, rhs->cols))
+		return false;
+	memset(res->data, 0, res->rows * res->cols * sizeof(double));
+	matmul(lhs->data, rhs->data, res->data, lhs->rows, inner, rhs->cols);
+	return true;
+}
+
+/* Applies unary operator to each element
+ * Returns false on failure */
+static bool map(const char *oper, struct Tensor *val) {
+	for (size_t index = 0; index < val->rows * val->cols; index++) {
+		if (!calc(oper, 0, val->data[index], &val->data[index])) {
+			drop(val);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void skip(struct Reader *rd) {
+	while (*rd->pos == ' ')	rd->pos++;
+}
+
+/* Consumes operator if it is next, but not the first half of a double operator */
+static bool accept(struct Reader *rd, const char *oper) {
+	size_t len = strlen(oper);
+
+	skip(rd);
+	if (strncmp(rd->pos, oper, len))
+		return false;
+	if (len == 1 && rd->pos[1] == oper[0] && ischr(oper[0], CHR_DOUBL))
+		return false;
+	rd->pos += len;
+	return true;
+}
+
+/* Returns true if next token multiplies by juxtaposition, x(y) */
+static bool implicit(struct Reader *rd) {
+	skip(rd);
+	return *rd->pos == '(' || *rd->pos == '[' || isdigit(*rd->pos) || *rd->pos == '.';
+}
+
+static bool binary(struct Reader *rd, unsigned prec, struct Tensor *val);
+
+/* Evaluates number, such as 1.5 or 2E-3 */
+static bool number(struct Reader *rd, struct Tensor *val) {
+	const char *end = rd->pos;
+	char *parsed;
+	double x;
+
+	end += strspn(end, "0123456789.");
+	if (*end == 'E') {
+		end++;
+		end += isparity(*end);
+		end += strspn(end, "0123456789");
+	}
+	x = strtod(rd->pos, &parsed);
+	if (parsed != end) {
+		rd->pos = parsed < end ? parsed : end;
+		syntax(rd, NULL);
+		return false;
+	}
+	rd->pos = end;
+	if (!alloc(val, 0, 1, 1))
+		return false;
+	*val->data = x;
+	return true;
+}
+
+/* Evaluates elements of literal following its opening bracket
+ * Elements must all be numbers, making a vector, or all vectors of the same length, making a matrix */
+static bool list(struct Reader *rd, struct Tensor *val) {
+	const char *open = rd->pos - 1;
+	struct Tensor elem;
+	double *data = NULL, *swap;
+	size_t count = 0, cap = 0, len = 0;
+	unsigned rank = 0;
+
+	do {
+		if (!binary(rd, PREC_MIN, &elem)) {
+			xfree(data);
+			return false;
+		}
+		if (elem.rank > 1 || count && (elem.rank != rank || elem.cols != len)) {
+			drop(&elem);
+			xfree(data);
+			setstat(ERR_SHAPE);
+			return false;
+		}
+		rank = elem.rank;
+		len = elem.cols;
+		if ((count + 1) * len > cap) {
+			cap = cap * 2 > (count + 1) * len ? cap * 2 : (count + 1) * len;
+			if (!(swap = xrealloc(data, cap * sizeof(double)))) {
+				drop(&elem);
+				xfree(data);
+				return false;
+			}
+			data = swap;
+		}
+		memcpy(data + count++ * len, elem.data, len * sizeof(double));
+		drop(&elem);
+	} while (accept(rd, ","));
+	if (!accept(rd, "]")) {
+		xfree(data);
+		syntax(rd, open);
+		return false;
+	}
+	*val = rank ? (struct Tensor) {2, count, len, data} : (struct Tensor) {1, 1, count, data};
+	return true;
+}
+
+/* Evaluates number, group, literal, or unary operation on any */
+static bool unary(struct Reader *rd, struct Tensor *val) {
+	const struct Operator *oper;
+	const char *open;
+	bool literal;
+
+	skip(rd);
+	if (!*rd->pos) {
+		setstat(ERR_MISSOPER);
+		return false;
+	}
+	if ((oper = lexoper(rd->pos, 2)) && oper->arity == 1) {
+		rd->pos += strlen(oper->symbol);
+		return unary(rd, val) && map(oper->symbol, val);
+	}
+	if (accept(rd, "+"))	// Sign
+		return unary(rd, val);
+	if (accept(rd, "-"))
+		return unary(rd, val) && map("-", val);
+	if (isdigit(*rd->pos) || *rd->pos == '.')
+		return number(rd, val);
+	if (*rd->pos == '(' || *rd->pos == '[') {
+		open = rd->pos;
+		literal = *rd->pos++ == '[';
+		if (++rd->depth > VEC_DEPTH) {
+			setstat(ERR_INPUTSIZE);
+			return false;
+		}
+		if (literal ? !list(rd, val) : !binary(rd, PREC_MIN, val))
+			return false;
+		if (!literal && !accept(rd, ")")) {
+			drop(val);
+			syntax(rd, open);
+			return false;
+		}
+		rd->depth--;
+		return true;
+	}
+	if (strchr(")],@", *rd->pos) || ischr(*rd->pos, CHR_OPER)) {
+		setstat(ERR_MISSOPER);
+		return false;
+	}
+	syntax(rd, NULL);
+	return false;
+}
+
+/* Consumes binary operator of given precedence if it is next, including products and multiplication by juxtaposition
+ * Returns its symbol, or NULL otherwise */
+static const char *match(struct Reader *rd, unsigned prec, direct_t *assoc) {
+	const struct Operator *oper;
+
+	skip(rd);
+	*assoc = LEFT;
+	if ((oper = lexoper(rd->pos, 2)) && oper->arity == 2 && oper->prec == prec) {
+		rd->pos += strlen(oper->symbol);
+		*assoc = oper->assoc;
+		return oper->symbol;
+	}
+	if (prec != Opers[OP_MUL].prec)
+		return NULL;
+	if (accept(rd, "@"))
+		return "@";
+	return implicit(rd) ? Opers[OP_MUL].symbol : NULL;
+}
+
+/* Evaluates operations of given precedence and higher */
+static bool binary(struct Reader *rd, unsigned prec, struct Tensor *val) {
+	struct Tensor rval, res;
+	const char *oper;
+	direct_t assoc;
+	bool success;
+
+	if (prec > PREC_BINARY)
+		return unary(rd, val);
+	if (!binary(rd, prec + 1, val))
+		return false;
+	while ((oper = match(rd, prec, &assoc))) {
+		if (!binary(rd, prec + (assoc == LEFT), &rval)) {
+			drop(val);
+			return false;
+		}
+		success = *oper == '@' ? product(val, &rval, &res) : elementwise(oper, val, &rval, &res);
+		drop(val);
+		drop(&rval);
+		if (!success)
+			return false;
+		*val = res;
+	}
+	return true;
+}
+
+/* Returns string of tensor, each row in brackets */
+static char *format(const struct Tensor *val, unsigned sig) {
+	char *str, *line, *swap;
+	size_t len = 0;
+
+	if (!val->rank)
+		return dtosv(val->data, 1, sig, "");
+	if (!(str = xstrdup("[")))
+		return NULL;
+	len = 1;
+	for (size_t row = 0; row < val->rows; row++) {
+		if (!(line = dtosv(val->data + row * val->cols, val->cols, sig, ", "))) {
+			xfree(str);
+			return NULL;
+		}
+		if (!(swap = xrealloc(str, len + strlen(line) + sizeof(", []]")))) {
+			xfree(line);
+			xfree(str);
+			return NULL;
+		}
+		str = swap;
+		len += sprintf(str + len, val->rank == 1 ? "%s%s" : "%s[%s]", row ? ", " : "", line);
+		xfree(line);
+	}
+	strcpy(str + len, "]");
+	return str;
+}
+
+char *parse_vec(const char *expr, unsigned sig) {
+	struct Reader rd = {expr, expr, 0};
+	struct Tensor val;
+	char *result;
+
+	if (!binary(&rd, PREC_MIN, &val))
+		return NULL;
+	skip(&rd);
+	if (*rd.pos) {
+		drop(&val);
+		syntax(&rd, NULL);
+		return NULL;
+	}
+	result = format(&val, sig);
+	drop(&val);
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef VEC_H
+#define VEC_H
+
+#include <string.h>	// strchr()
+#include "global.h"	// attribute()
+
+/* Vector and matrix expressions
+ * [x, y, z] is a vector, and [[a, b], [c, d]] a matrix of rows
+ * Operators apply element-wise, broadcasting operands of size 1 along either dimension, as numpy does
+ * x@y is the dot product of vectors, or the matrix product otherwise
+ * Evaluated in doubles, even in fixed-point mode, where results are only rounded to its scale */
+
+#define VEC_BLOCK	64	// Edge of tiles of matrix product, in elements
+
+/* Returns true if expression contains vectors or matrices */
+#define isvec(expr)	(strchr(expr, '[') != NULL)
+
+/* Evaluates expression of vectors and matrices
+ * Returns string representation of result, e.g. [1, 2] or [[1, 2], [3, 4]]
+ * On success, result must be freed
+ * Returns NULL on failure */
+extern char *parse_vec(const char *expr, unsigned sig)
+attribute(__warn_unused_result__, __nonnull__(1));
+
+#endif // #ifndef VEC_H
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+#include "mem.h"
+#include "parse.h"
+#include "status.h"
+#include "stmt.h"
+#include "watch.h"
+
+#if LINUX
+#include <libgen.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define WATCH_EVENTS	(IN_CLOSE_WRITE | IN_MOVED_TO)	// Saved in place, or replaced by rename
+#define EVENT_BUF		4096
+
+struct Line {
+	char *text;
+	uint64_t hash;
+	char *result;	// NULL if line is blank or failed
+	bool taken;		// Matched by line of newer version?
+};
+
+/* Lines of one version of sheet */
+struct Sheet {
+	struct Line *lines;
+	size_t len;
+	size_t *index;	// Open-addressed table of lines by hash, SIZE_MAX where empty
+	size_t mask;
+};
+
+static volatile sig_atomic_t Stop = false;
+
+static void onsignal(int sig) {Stop = true;}
+
+static uint64_t hashline(const char *str) {
+	uint64_t hash = 14695981039346656037ULL;	// FNV-1a, as cache.c
+
+	for (; *str; str++) {
+		hash ^= (unsigned char) *str;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static void clrsheet(struct Sheet *sheet) {
+	for (size_t line = 0; line < sheet->len; line++) {
+		free(sheet->lines[line].text);
+		xfree(sheet->lines[line].result);
+	}
+	free(sheet->lines);
+	free(sheet->index);
+	*sheet = (struct Sheet) {0};
+}
+
+/* Reads every line of file into sheet, indexed by hash
+ * Returns false on failure */
+static bool readsheet(const char *path, struct Sheet *sheet) {
+	FILE *file;
+	struct Line *swap;
+	char *text = NULL;
+	size_t cap = 0, size = 0, slot;
+	ssize_t len;
+
+	if (!(file = fopen(path, "r")))
+		return false;
+	while ((len = getline(&text, &size, file)) >= 0) {
+		if (sheet->len == cap) {
+			if (!(swap = realloc(sheet->lines, (cap = cap ? cap * 2 : 64) * sizeof(struct Line))))
+				break;
+			sheet->lines = swap;
+		}
+		if (len && text[len - 1] == '\n')
+			text[len - 1] = '\0';
+		sheet->lines[sheet->len++] = (struct Line) {text, hashline(text), NULL, false};
+		text = NULL, size = 0;
+	}
+	free(text);
+	fclose(file);
+	if (len >= 0)
+		return false;
+	for (sheet->mask = 1; sheet->mask < sheet->len * 2; sheet->mask *= 2);
+	if (!(sheet->index = malloc(sheet->mask-- * sizeof(size_t))))
+		return false;
+	memset(sheet->index, 0xFF, (sheet->mask + 1) * sizeof(size_t));
+	for (size_t line = 0; line < sheet->len; line++) {
+		for (slot = sheet->lines[line].hash & sheet->mask; sheet->index[slot] != SIZE_MAX; slot = (slot + 1) & sheet->mask);
+		sheet->index[slot] = line;
+	}
+	return true;
+}
+
+/* Takes earlier line of same text not yet matched, wherever it was, so that inserting or removing a line
+ * leaves the lines after it matched
+ * Returns NULL if there is none */
+static struct Line *match(struct Sheet *old, const struct Line *line) {
+	struct Line *was;
+
+	if (!old->index)
+		return NULL;
+	for (size_t slot = line->hash & old->mask; old->index[slot] != SIZE_MAX; slot = (slot + 1) & old->mask) {
+		was = &old->lines[old->index[slot]];
+		if (!was->taken && was->hash == line->hash && !strcmp(was->text, line->text)) {
+			was->taken = true;	// Duplicate lines take one each
+			return was;
+		}
+	}
+	return NULL;
+}
+
+/* Rereads sheet, printing result of each line not matched by a line of the same text in the earlier version
+ * Returns false on failure */
+static bool update(const char *path, struct Sheet *sheet, unsigned sig) {
+	struct Sheet new = {0};
+	struct Line *line, *was;
+
+	if (!readsheet(path, &new)) {
+		clrsheet(&new);
+		return false;
+	}
+	for (size_t index = 0; index < new.len; index++) {
+		line = &new.lines[index];
+		if ((was = match(sheet, line)) && (!was->result || (line->result = xstrdup(was->result))))	// Unchanged
+			continue;
+		if (!line->text[strspn(line->text, " \t")])	// Blank
+			continue;
+		clrstat();
+		clrvars();	// Lines are independent, so none sees assignments of another or of an earlier version
+		line->result = parse_line(line->text, sig);
+		printf(SIZE_FMT ": ", index + 1);
+		if (line->result)
+			puts(line->result);
+		else
+			pstatus();
+	}
+	fflush(stdout);
+	clrsheet(sheet);
+	*sheet = new;
+	return true;
+}
+#endif // #if LINUX
+
+bool watch(const char *path, unsigned sig) {
+#if LINUX
+	struct sigaction act = {.sa_handler = onsignal};
+	struct Sheet sheet = {0};
+	const struct inotify_event *event;
+	char buf[EVENT_BUF] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char *dir, *base, *name;
+	ssize_t len;
+	int fd;
+	bool ok = true;
+
+	if (!(dir = strdup(path)) || !(base = strdup(path))) {
+		free(dir);
+		setstat(ERR_INTERNAL);
+		return false;
+	}
+	name = basename(base);
+	sigaction(SIGINT, &act, NULL);	// No SA_RESTART, so read() returns
+	sigaction(SIGTERM, &act, NULL);
+	if ((fd = inotify_init1(IN_CLOEXEC)) < 0 || inotify_add_watch(fd, dirname(dir), WATCH_EVENTS) < 0 ||	// Directory, so that replacing file is seen
+		!update(path, &sheet, sig)) {
+		ok = false;
+		goto done;
+	}
+	while (!Stop && ok) {
+		if ((len = read(fd, buf, sizeof(buf))) <= 0) {
+			ok = len < 0 && errno == EINTR;
+			continue;
+		}
+		for (char *pos = buf; pos < buf + len; pos += sizeof(struct inotify_event) + event->len) {
+			event = (const struct inotify_event *) pos;
+			if (event->len && !strcmp(event->name, name))
+				update(path, &sheet, sig);	// If file has gone, waits for it to be written again
+		}
+	}
+done:
+	if (!ok)
+		setstat(ERR_INTERNAL);
+	if (fd >= 0)
+		close(fd);
+	clrsheet(&sheet);
+	free(dir);
+	free(base);
+	return ok;
+#else
+	errno = ENOSYS;
+	setstat(ERR_INTERNAL);
+	return false;
+#endif // #if LINUX
+}
\ No newline at end of file
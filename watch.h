@@ -0,0 +1,18 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdbool.h>	// bool
+#include "global.h"		// attribute()
+
+/* Watch mode
+ * A sheet is a text file of one expression, or set of statements, per line
+ * Whenever it is saved, lines whose text is new are evaluated and printed as 'line: result'
+ * Lines whose text was already in the sheet keep their earlier result and are not printed, even if they moved
+ * Lines depend on nothing but their own text, so variables assigned on one line do not cause others to be evaluated again */
+
+/* Evaluates every line of sheet, then each changed line whenever the file is written or replaced, until interrupted
+ * Returns false on failure */
+extern bool watch(const char *path, unsigned sig)
+attribute(__nonnull__(1));
+
+#endif // #ifndef WATCH_H
\ No newline at end of file